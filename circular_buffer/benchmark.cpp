@@ -0,0 +1,458 @@
+// Benchmark the circular buffer variants
+//
+// Usage: benchmark [--megabytes <n>] [--round-trips <n>]
+//
+// Every variant is run over a range of message sizes and buffer capacities,
+// measuring:
+// - single-threaded throughput, writing and then reading half a buffer at a time
+// - cross-thread throughput, with a producer thread and a consumer thread
+// - round-trip latency percentiles, bouncing a message between two threads
+//   through a pair of buffers
+// Each throughput run moves 64MB by default and each latency run makes 10000
+// round trips. Variants that are not thread-safe only have single-threaded
+// results, and the lossy telemetry buffer has no round trips since it may drop
+// the message. The results are printed as a JSON array with one object per run.
+//
+// Circular in circular_buffer.cpp is a demonstration program rather than a
+// header, so it is not included; Circular<T> in template.hpp stands in for it.
+
+#include <algorithm>    // For sort
+#include <chrono>       // For steady_clock
+#include <cstdlib>      // For atoi
+#include <cstring>      // For strcmp
+#include <iostream>     // For cout etc
+#include <sstream>      // For ostringstream
+#include <string>       // For string, to_string
+#include <thread>       // For thread, yield
+#include <vector>       // For vector
+
+#include <unistd.h>     // For getpid
+
+#include "blocking.hpp"
+#include "disruptor.hpp"
+#include "mirrored.hpp"
+#include "mpmc.hpp"
+#include "shared.hpp"
+#include "spsc.hpp"
+#include "telemetry.hpp"
+#include "template.hpp"
+
+using namespace std;
+
+// A message of S bytes, stamped with its sequence number at both ends so that
+// lost, duplicated or torn messages are noticed
+template<size_t S>
+struct Message {
+    char data[S];
+
+    void stamp(size_t i) {
+        data[0] = static_cast<char>(i);
+        data[S - 1] = static_cast<char>(i >> 8);
+    }
+
+    bool check(size_t i) const {
+        return (data[0] == static_cast<char>(i)) && (data[S - 1] == static_cast<char>(i >> 8));
+    }
+};
+
+// Adapters giving every variant the same interface: push() and pop() one
+// message, waiting if the variant is thread-safe and the buffer is full or
+// empty. Each is constructed with the capacity in bytes
+
+// SpscCircular, yielding while full or empty
+template<size_t S>
+class SpscAdapter {
+public:
+    static const bool concurrent = true;
+    static const bool lossy = false;
+    static const char* name() { return "spsc"; }
+
+    SpscAdapter(size_t bytes) : ring(bytes) {}
+
+    void push(const Message<S>& message) {
+        for(size_t done = 0; done < S; ) {
+            size_t count = ring.write(message.data + done, S - done);
+            if(count == 0) {
+                this_thread::yield();
+            }
+            done += count;
+        }
+    }
+
+    void pop(Message<S>& message) {
+        for(size_t done = 0; done < S; ) {
+            size_t count = ring.read(message.data + done, S - done);
+            if(count == 0) {
+                this_thread::yield();
+            }
+            done += count;
+        }
+    }
+
+private:
+    SpscCircular ring;
+};
+
+// BlockingCircular, parking while full or empty
+template<size_t S>
+class BlockingAdapter {
+public:
+    static const bool concurrent = true;
+    static const bool lossy = false;
+    static const char* name() { return "blocking"; }
+
+    BlockingAdapter(size_t bytes) : ring(bytes) {}
+
+    void push(const Message<S>& message) { ring.push(message.data, S); }
+    void pop(Message<S>& message) { ring.pop(message.data, S); }
+
+private:
+    BlockingCircular<ParkingWait> ring;
+};
+
+// MirroredCircular, not thread-safe
+template<size_t S>
+class MirroredAdapter {
+public:
+    static const bool concurrent = false;
+    static const bool lossy = false;
+    static const char* name() { return "mirrored"; }
+
+    MirroredAdapter(size_t bytes) : ring(bytes) {}
+
+    void push(const Message<S>& message) { ring.write(message.data, S); }
+    void pop(Message<S>& message) { ring.read(message.data, S); }
+
+private:
+    MirroredCircular ring;
+};
+
+// SharedCircular used between two threads of one process
+template<size_t S>
+class SharedAdapter {
+public:
+    static const bool concurrent = true;
+    static const bool lossy = false;
+    static const char* name() { return "shared"; }
+
+    SharedAdapter(size_t bytes) : ring(("/circular_buffer_benchmark." + to_string(getpid()) + "." + to_string(count++)).c_str(), bytes) {}
+
+    void push(const Message<S>& message) { ring.push(message.data, S); }
+    void pop(Message<S>& message) { ring.pop(message.data, S); }
+
+private:
+    static unsigned int count;  // to give each buffer a different name
+    SharedCircular ring;
+};
+
+template<size_t S>
+unsigned int SharedAdapter<S>::count = 0;
+
+// Circular<T> of messages, not thread-safe
+template<size_t S>
+class TemplateAdapter {
+public:
+    static const bool concurrent = false;
+    static const bool lossy = false;
+    static const char* name() { return "template"; }
+
+    TemplateAdapter(size_t bytes) : ring(bytes / S) {}
+
+    void push(const Message<S>& message) { ring.write(message); }
+    void pop(Message<S>& message) { message = ring.read(); }
+
+private:
+    Circular<Message<S>> ring;
+};
+
+// MpmcQueue of messages
+template<size_t S>
+class MpmcAdapter {
+public:
+    static const bool concurrent = true;
+    static const bool lossy = false;
+    static const char* name() { return "mpmc"; }
+
+    MpmcAdapter(size_t bytes) : queue(bytes / S) {}
+
+    void push(const Message<S>& message) { queue.push(message); }
+    void pop(Message<S>& message) { queue.pop(message); }
+
+private:
+    MpmcQueue<Message<S>> queue;
+};
+
+// Disruptor of messages with a single consumer
+template<size_t S>
+class DisruptorAdapter {
+public:
+    static const bool concurrent = true;
+    static const bool lossy = false;
+    static const char* name() { return "disruptor"; }
+
+    DisruptorAdapter(size_t bytes) : ring(bytes / S), consumer(ring.add_consumer()), next(0) {}
+
+    void push(const Message<S>& message) {
+        size_t position = ring.claim(1);
+        ring.at(position) = message;
+        ring.publish(position + 1);
+    }
+
+    void pop(Message<S>& message) {
+        ring.wait_for(consumer, next);
+        message = ring.at(next);
+        ring.release(consumer, ++next);
+    }
+
+private:
+    Disruptor<Message<S>> ring;
+    size_t consumer;
+    size_t next;                // consumer only
+};
+
+// TelemetryCircular of messages, popping from the last batch drained
+template<size_t S>
+class TelemetryAdapter {
+public:
+    static const bool concurrent = true;
+    static const bool lossy = true;
+    static const char* name() { return "telemetry"; }
+
+    TelemetryAdapter(size_t bytes) : ring(bytes / S), next(0) {}
+
+    void push(const Message<S>& message) { ring.write(message); }
+
+    void pop(Message<S>& message) {
+        while(next == drained.size()) {
+            ring.drain(drained);
+            next = 0;
+        }
+        message = drained[next++];
+    }
+
+    size_t written() const { return ring.written(); }
+    size_t dropped() const { return ring.dropped(); }
+    size_t drain() { return ring.drain(drained); }
+    const vector<Message<S>>& batch() const { return drained; }
+
+private:
+    TelemetryCircular<Message<S>> ring;
+    vector<Message<S>> drained; // consumer only
+    size_t next;                // consumer only
+};
+
+// Start a JSON object for one run
+string start_result(const char* variant, const char* mode, size_t message_bytes, size_t capacity_bytes) {
+    ostringstream json;
+    json << "{\"variant\": \"" << variant << "\", \"mode\": \"" << mode << "\", "
+         << "\"message_bytes\": " << message_bytes << ", \"capacity_bytes\": " << capacity_bytes;
+    return json.str();
+}
+
+// Print one result as an element of the JSON array
+void emit(const string& json) {
+    static bool first = true;
+    cout << (first ? "[\n  " : ",\n  ") << json << "}" << flush;
+    first = false;
+}
+
+// A throughput result
+string throughput(double seconds, size_t messages, size_t message_bytes, bool correct) {
+    ostringstream json;
+    json << ", \"seconds\": " << seconds
+         << ", \"messages_per_second\": " << messages / seconds
+         << ", \"megabytes_per_second\": " << messages * message_bytes / seconds / 1e6
+         << ", \"correct\": " << (correct ? "true" : "false");
+    return json.str();
+}
+
+// Write and then read half a buffer at a time on one thread
+template<template<size_t> class Adapter, size_t S>
+void single_threaded(size_t capacity, size_t messages) {
+    Adapter<S> ring(capacity);
+    size_t batch = max(capacity / S / 2, static_cast<size_t>(1));
+    Message<S> message = {};
+    bool correct = true;
+
+    auto start = chrono::steady_clock::now();
+    for(size_t i = 0; i < messages; i += batch) {
+        size_t n = min(batch, messages - i);
+        for(size_t j = 0; j < n; j++) {
+            message.stamp(i + j);
+            ring.push(message);
+        }
+        for(size_t j = 0; j < n; j++) {
+            ring.pop(message);
+            correct = correct && message.check(i + j);
+        }
+    }
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+
+    emit(start_result(Adapter<S>::name(), "single_threaded", S, capacity) +
+         throughput(elapsed.count(), messages, S, correct));
+}
+
+// Stream messages from a producer thread to a consumer thread
+template<template<size_t> class Adapter, size_t S>
+void cross_thread(size_t capacity, size_t messages) {
+    Adapter<S> ring(capacity);
+    bool correct = true;
+
+    auto start = chrono::steady_clock::now();
+    thread consumer([&]() {
+        Message<S> message = {};
+        for(size_t i = 0; i < messages; i++) {
+            ring.pop(message);
+            correct = correct && message.check(i);
+        }
+    });
+    Message<S> message = {};
+    for(size_t i = 0; i < messages; i++) {
+        message.stamp(i);
+        ring.push(message);
+    }
+    consumer.join();
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+
+    emit(start_result(Adapter<S>::name(), "cross_thread", S, capacity) +
+         throughput(elapsed.count(), messages, S, correct));
+}
+
+// Stream messages from a producer thread to a consumer thread that drains
+// whatever is left, counting how many were delivered rather than dropped
+//
+// Each drained batch is the run of messages just before the total delivered
+// and dropped so far, so every message in it is checked against its position,
+// and at the end every message must have been either delivered or dropped
+template<size_t S>
+void cross_thread_lossy(size_t capacity, size_t messages) {
+    TelemetryAdapter<S> ring(capacity);
+    size_t delivered = 0;
+    bool correct = true;
+
+    auto start = chrono::steady_clock::now();
+    thread consumer([&]() {
+        for(bool done = false; !done; ) {
+            done = (ring.written() == messages);  // drain once more after the producer finishes
+            size_t n = ring.drain();
+            delivered += n;
+            size_t end = delivered + ring.dropped();
+            for(size_t j = 0; j < n; j++) {
+                correct = correct && ring.batch()[j].check(end - n + j);
+            }
+        }
+    });
+    Message<S> message = {};
+    for(size_t i = 0; i < messages; i++) {
+        message.stamp(i);
+        ring.push(message);
+    }
+    consumer.join();
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+
+    size_t dropped = ring.dropped();
+    correct = correct && (delivered > 0) && (delivered + dropped == messages);
+    ostringstream json;
+    json << ", \"delivered_fraction\": " << static_cast<double>(delivered) / messages << ", \"dropped\": " << dropped;
+    emit(start_result(TelemetryAdapter<S>::name(), "cross_thread", S, capacity) +
+         throughput(elapsed.count(), messages, S, correct) + json.str());
+}
+
+// Bounce a message between two threads through a pair of buffers
+template<template<size_t> class Adapter, size_t S>
+void round_trip(size_t capacity, unsigned int round_trips) {
+    Adapter<S> ping(capacity);
+    Adapter<S> pong(capacity);
+    vector<double> latencies(round_trips);
+    bool correct = true;
+
+    thread echo([&]() {
+        Message<S> message = {};
+        for(unsigned int i = 0; i < round_trips; i++) {
+            ping.pop(message);
+            pong.push(message);
+        }
+    });
+    Message<S> message = {};
+    for(unsigned int i = 0; i < round_trips; i++) {
+        message.stamp(i);
+        auto start = chrono::steady_clock::now();
+        ping.push(message);
+        pong.pop(message);
+        chrono::duration<double, nano> elapsed = chrono::steady_clock::now() - start;
+        latencies[i] = elapsed.count();
+        correct = correct && message.check(i);
+    }
+    echo.join();
+
+    sort(latencies.begin(), latencies.end());
+    auto percentile = [&](double p) { return latencies[static_cast<size_t>(p * (round_trips - 1))]; };
+    ostringstream json;
+    json << ", \"round_trips\": " << round_trips
+         << ", \"p50_ns\": " << percentile(0.5)
+         << ", \"p90_ns\": " << percentile(0.9)
+         << ", \"p99_ns\": " << percentile(0.99)
+         << ", \"p999_ns\": " << percentile(0.999)
+         << ", \"max_ns\": " << latencies.back()
+         << ", \"correct\": " << (correct ? "true" : "false");
+    emit(start_result(Adapter<S>::name(), "round_trip", S, capacity) + json.str());
+}
+
+// Run every benchmark that applies to a variant for one message size
+template<template<size_t> class Adapter, size_t S>
+void run(const vector<size_t>& capacities, size_t megabytes, unsigned int round_trips) {
+    size_t messages = megabytes * 1024 * 1024 / S;
+    for(size_t capacity : capacities) {
+        single_threaded<Adapter, S>(capacity, messages);
+        if(Adapter<S>::lossy) {
+            cross_thread_lossy<S>(capacity, messages);
+        }
+        else if(Adapter<S>::concurrent) {
+            cross_thread<Adapter, S>(capacity, messages);
+            round_trip<Adapter, S>(capacity, round_trips);
+        }
+    }
+}
+
+// Run every benchmark that applies to a variant for every message size
+template<template<size_t> class Adapter>
+void run_sizes(const vector<size_t>& capacities, size_t megabytes, unsigned int round_trips) {
+    run<Adapter, 8>(capacities, megabytes, round_trips);
+    run<Adapter, 64>(capacities, megabytes, round_trips);
+    run<Adapter, 512>(capacities, megabytes, round_trips);
+}
+
+int main(int argc, char* argv[]) {
+    size_t megabytes = 64;
+    unsigned int round_trips = 10000;
+
+    for(int i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "--megabytes") == 0 && i + 1 < argc) {
+            megabytes = atoi(argv[++i]);
+        }
+        else if(strcmp(argv[i], "--round-trips") == 0 && i + 1 < argc) {
+            round_trips = atoi(argv[++i]);
+        }
+        else {
+            megabytes = 0;
+            break;
+        }
+    }
+    if((megabytes == 0) || (round_trips == 0)) {
+        cerr << "Usage: " << argv[0] << " [--megabytes <n>] [--round-trips <n>]" << endl;
+        return 1;
+    }
+
+    // Capacities in bytes, from fitting in L1 to spilling out of L2
+    vector<size_t> capacities = { 4096, 65536, 1048576 };
+
+    run_sizes<SpscAdapter>(capacities, megabytes, round_trips);
+    run_sizes<BlockingAdapter>(capacities, megabytes, round_trips);
+    run_sizes<MirroredAdapter>(capacities, megabytes, round_trips);
+    run_sizes<SharedAdapter>(capacities, megabytes, round_trips);
+    run_sizes<TemplateAdapter>(capacities, megabytes, round_trips);
+    run_sizes<MpmcAdapter>(capacities, megabytes, round_trips);
+    run_sizes<DisruptorAdapter>(capacities, megabytes, round_trips);
+    run_sizes<TelemetryAdapter>(capacities, megabytes, round_trips);
+    cout << "\n]" << endl;
+}
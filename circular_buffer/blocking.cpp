@@ -0,0 +1,97 @@
+// Blocking push and pop on a circular buffer, with a benchmark of the round-trip
+// latency and CPU time of each wait strategy
+//
+// Usage: blocking [<round trips>]
+//
+// Two threads bounce a message back and forth through a pair of buffers
+// (10000 times by default) and the latency percentiles of each round trip are
+// reported, along with the CPU time used by the whole process per round trip.
+// Busy-spinning only makes sense with at least one core per thread.
+
+#include <algorithm>    // For sort
+#include <chrono>       // For steady_clock
+#include <cstdlib>      // For atoi
+#include <ctime>        // For clock
+#include <iomanip>      // For setw
+#include <iostream>     // For cout etc
+#include <string>       // For string
+#include <thread>       // For thread
+#include <vector>       // For vector
+
+#include "blocking.hpp"
+
+using namespace std;
+
+// Bounce a message between two threads and report the round-trip latencies
+template<typename Wait>
+void ping_pong(const string& name, unsigned int round_trips) {
+    BlockingCircular<Wait> ping(64);
+    BlockingCircular<Wait> pong(64);
+    vector<double> latencies(round_trips);
+
+    thread echo([&]() {
+        char message[8];
+        for(unsigned int i = 0; i < round_trips; i++) {
+            ping.pop(message, sizeof(message));
+            pong.push(message, sizeof(message));
+        }
+    });
+
+    clock_t cpu = clock();
+    bool correct = true;
+    for(unsigned int i = 0; i < round_trips; i++) {
+        char message[8] = { static_cast<char>(i) };
+        auto start = chrono::steady_clock::now();
+        ping.push(message, sizeof(message));
+        pong.pop(message, sizeof(message));
+        chrono::duration<double, micro> elapsed = chrono::steady_clock::now() - start;
+        latencies[i] = elapsed.count();
+        correct = correct && (message[0] == static_cast<char>(i));
+    }
+    echo.join();
+    double cpu_per_trip = 1e6 * (clock() - cpu) / CLOCKS_PER_SEC / round_trips;
+
+    sort(latencies.begin(), latencies.end());
+    auto percentile = [&](double p) { return latencies[static_cast<size_t>(p * (round_trips - 1))]; };
+
+    cout << setw(12) << left << name << right << fixed << setprecision(2)
+         << setw(10) << percentile(0.5)
+         << setw(10) << percentile(0.9)
+         << setw(10) << percentile(0.99)
+         << setw(10) << percentile(0.999)
+         << setw(10) << latencies.back()
+         << setw(10) << cpu_per_trip
+         << (correct ? "" : "  incorrect") << endl;
+}
+
+int main(int argc, char* argv[]) {
+    unsigned int round_trips = (argc > 1) ? atoi(argv[1]) : 10000;
+    if(round_trips == 0) {
+        cout << "Usage: " << argv[0] << " [<round trips>]" << endl;
+        return 1;
+    }
+
+    // Blocking instead of throwing: a push larger than the buffer completes as
+    // the consumer makes room
+    BlockingCircular<ParkingWait> circular(16);
+    string sent(1000, ' ');
+    for(size_t i = 0; i < sent.size(); i++) {
+        sent[i] = 'a' + i % 26;
+    }
+    string received(sent.size(), ' ');
+    thread consumer([&]() { circular.pop(&received[0], received.size()); });
+    circular.push(sent.data(), sent.size());
+    consumer.join();
+    cout << "Pushed " << sent.size() << " bytes through a buffer of " << circular.capacity() << ": "
+         << (received == sent ? "correct" : "incorrect") << endl;
+    cout << endl;
+
+    cout << "Round-trip latency in microseconds and CPU microseconds per round trip, "
+         << thread::hardware_concurrency() << " hardware threads:" << endl;
+    cout << setw(12) << left << "Strategy" << right
+         << setw(10) << "p50" << setw(10) << "p90" << setw(10) << "p99"
+         << setw(10) << "p99.9" << setw(10) << "max" << setw(10) << "CPU" << endl;
+    ping_pong<BusySpinWait>("busy-spin", round_trips);
+    ping_pong<SpinYieldWait>("spin-yield", round_trips);
+    ping_pong<ParkingWait>("parking", round_trips);
+}
@@ -0,0 +1,147 @@
+// A blocking single-producer/single-consumer circular buffer of bytes, with
+// pluggable strategies for how to wait when it is empty or full
+
+#ifndef BLOCKING_H
+#define BLOCKING_H
+
+#include <atomic>               // For atomic, atomic_thread_fence
+#include <condition_variable>   // For condition_variable
+#include <cstddef>              // For size_t
+#include <mutex>                // For mutex, unique_lock
+#include <thread>               // For yield
+
+#include "spsc.hpp"
+
+// Each wait strategy provides:
+// - wait(ready): return once ready() is true
+// - notify(): called after something that may make ready() true for a waiter
+
+// Spin on the condition: the lowest latency, but burns a whole core while
+// waiting and is a poor choice with fewer cores than threads
+class BusySpinWait {
+public:
+    template<typename Ready>
+    void wait(Ready ready) {
+        while(!ready()) {
+        }
+    }
+
+    void notify() {
+    }
+};
+
+// Spin on the condition for a while, then yield the core to other threads
+// between checks
+class SpinYieldWait {
+public:
+    template<typename Ready>
+    void wait(Ready ready) {
+        for(unsigned int spins = 0; !ready(); spins++) {
+            if(spins > SPINS) {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    void notify() {
+    }
+
+private:
+    static const unsigned int SPINS = 100;
+};
+
+// Spin for a while, then park the thread on a condition variable (a futex on
+// Linux) until notified: the least CPU burnt while waiting, but the highest
+// latency to wake up
+//
+// The notifier only takes the lock and makes a system call if a thread is
+// actually parked. The fences make sure that either the waiter sees the new
+// state before parking or the notifier sees the waiter and wakes it
+class ParkingWait {
+public:
+    ParkingWait() : waiters(0) {}
+
+    template<typename Ready>
+    void wait(Ready ready) {
+        for(unsigned int spins = 0; spins < SPINS; spins++) {
+            if(ready()) {
+                return;
+            }
+        }
+
+        waiters.fetch_add(1);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, ready);
+        }
+        waiters.fetch_sub(1);
+    }
+
+    void notify() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if(waiters.load(std::memory_order_relaxed) > 0) {
+            std::lock_guard<std::mutex> lock(mutex);
+            condition.notify_all();
+        }
+    }
+
+private:
+    static const unsigned int SPINS = 100;
+
+    std::atomic<int> waiters;
+    std::mutex mutex;
+    std::condition_variable condition;
+};
+
+// Unlike Circular, which throws runtime_error when it is empty or full, push()
+// and pop() wait using the Wait strategy until they can complete
+template<typename Wait>
+class BlockingCircular {
+public:
+    BlockingCircular(size_t n) : ring(n) {}                 // constructor - create a buffer to hold at least n bytes
+
+    size_t capacity() const { return ring.capacity(); }    // the number of bytes the buffer can hold
+
+    void push(const char* data, size_t nelements);          // producer only - write nelements bytes, waiting for room
+    void pop(char* data, size_t nelements);                 // consumer only - read nelements bytes, waiting for them
+
+private:
+    SpscCircular ring;
+    Wait not_empty;                                         // the consumer waits on this, the producer notifies it
+    Wait not_full;                                          // the producer waits on this, the consumer notifies it
+};
+
+// Write nelements bytes, waiting for room
+template<typename Wait>
+void BlockingCircular<Wait>::push(const char* data, size_t nelements) {
+    for(size_t done = 0; ; ) {
+        size_t count = ring.write(data + done, nelements - done);
+        if(count > 0) {
+            not_empty.notify();
+            done += count;
+        }
+        if(done == nelements) {
+            return;
+        }
+        not_full.wait([this]() { return ring.available() > 0; });
+    }
+}
+
+// Read nelements bytes, waiting for them
+template<typename Wait>
+void BlockingCircular<Wait>::pop(char* data, size_t nelements) {
+    for(size_t done = 0; ; ) {
+        size_t count = ring.read(data + done, nelements - done);
+        if(count > 0) {
+            not_full.notify();
+            done += count;
+        }
+        if(done == nelements) {
+            return;
+        }
+        not_empty.wait([this]() { return !ring.empty(); });
+    }
+}
+
+#endif
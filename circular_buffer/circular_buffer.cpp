@@ -1,8 +1,16 @@
 // A circular buffer (or ring buffer) using an array
 
-#include <algorithm>    // For copy, fill
+#include <algorithm>    // For copy, fill, min
+#include <cerrno>       // For errno
+#include <cstring>      // For strerror, strlen
 #include <iomanip>      // For setw
 #include <iostream>     // For cout etc
+#include <stdexcept>    // For runtime_error
+#include <string>       // For string
+
+#include <fcntl.h>      // For fcntl, O_NONBLOCK
+#include <sys/uio.h>    // For iovec, readv, writev
+#include <unistd.h>     // For close, pipe, read, write
 
 using namespace std;
 
@@ -17,25 +25,28 @@ public:
     void print() const;                                     // print a representation of a circular buffer
     char read();                                            // read one at a time from the head of the circular buffer
     void read(char* data, unsigned int nelements);          // read many at a time from the head of the circular buffer
+    ssize_t read_from_fd(int fd);                           // read from a file descriptor into the tail of the circular buffer
     unsigned int size() const;                              // the number of used elements currently in the buffer
     void write(char c);                                     // write one at a time to the tail of the circular buffer
     void write(const char* data, unsigned int nelements);   // write many at a time to the tail of the circular buffer
+    ssize_t write_to_fd(int fd);                            // write to a file descriptor from the head of the circular buffer
 
 private:
     unsigned int head;
     unsigned int tail;
+    unsigned int used;                                      // head == tail both when empty and when full
     unsigned int capacity;
     char* buffer;
 };
 
 // Constructor - create a circular buffer to hold n elements
-Circular::Circular(int n) : head(0), tail(0), capacity(n), buffer(new char[n]) {
+Circular::Circular(int n) : head(0), tail(0), used(0), capacity(n), buffer(new char[n]) {
     fill(buffer, buffer + capacity, ' ');
 }
 
 // Destructor - destroy the circular buffer
 Circular::~Circular() {
-    delete buffer;
+    delete[] buffer;
 }
 
 // The number of unused elements available in the buffer
@@ -48,11 +59,12 @@ void Circular::clear() {
     fill(buffer, buffer + capacity, ' ');
     head = 0;
     tail = 0;
+    used = 0;
 }
 
 // Is the buffer empty?
 bool Circular::empty() const {
-    return head == tail;
+    return used == 0;
 }
 
 // Print a representation of a circular buffer
@@ -79,18 +91,7 @@ void Circular::print() const {
 
 // The number of used elements currently in the buffer
 unsigned int Circular::size() const {
-    // Without wrap-around i.e [..H...T..]
-    if(head < tail) {
-        return tail - head;
-    }
-    // With wrap-around i.e [..T...H..]
-    else if(head > tail) {
-        return capacity - (head - tail);
-    }
-    // Empty
-    else {
-        return 0;
-    }
+    return used;
 }
 
 // Read one at a time from the head of the circular buffer
@@ -103,6 +104,7 @@ char Circular::read() {
     buffer[head] = ' '; // remove from the head
     head++;             // move the head rightwards
     head %= capacity;   // allow the head to wrap-around
+    used--;
     return value;
 }
 
@@ -141,6 +143,43 @@ void Circular::read(char* data, unsigned int nelements) {
     // Move the head rightwards and allow it to wrap-around
     head += nelements;
     head %= capacity;
+    used -= nelements;
+}
+
+// Read from a file descriptor into the tail of the circular buffer
+//
+// The free space is one or two segments, either side of the wrap point, and
+// both are filled by a single readv() with no intermediate buffer. Returns the
+// number of bytes read, 0 at end of file, or -1 if the file descriptor is
+// non-blocking and has no data
+ssize_t Circular::read_from_fd(int fd) {
+    if(available() == 0) {
+        throw runtime_error("Invalid operation: the buffer is full");
+    }
+
+    // From the tail rightwards, then from the start of the buffer
+    unsigned int right = min(available(), capacity - tail);
+    iovec segments[2] = {
+        { buffer + tail, right },
+        { buffer, available() - right }
+    };
+
+    ssize_t count;
+    do {
+        count = readv(fd, segments, segments[1].iov_len ? 2 : 1);
+    } while((count < 0) && (errno == EINTR));
+    if(count < 0) {
+        if((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+            return -1;
+        }
+        throw runtime_error(string("readv: ") + strerror(errno));
+    }
+
+    // Move the tail rightwards and allow it to wrap-around
+    tail += count;
+    tail %= capacity;
+    used += count;
+    return count;
 }
 
 // Write one at a time to the tail of the circular buffer
@@ -152,6 +191,7 @@ void Circular::write(char c) {
     buffer[tail] = c;   // append at the tail
     tail++;             // move the tail rightwards
     tail %= capacity;   // allow the tail to wrap-around
+    used++;
 }
 
 // Write many at a time to the tail of the circular buffer
@@ -185,6 +225,46 @@ void Circular::write(const char* data, unsigned int nelements) {
     // Move the tail rightwards and allow it to wrap-around
     tail += nelements;
     tail %= capacity;
+    used += nelements;
+}
+
+// Write to a file descriptor from the head of the circular buffer
+//
+// The used space is one or two segments, either side of the wrap point, and
+// both are sent by a single writev() with no intermediate buffer. Returns the
+// number of bytes written, or -1 if the file descriptor is non-blocking and
+// has no room
+ssize_t Circular::write_to_fd(int fd) {
+    if(empty()) {
+        throw runtime_error("Invalid operation: the buffer is empty");
+    }
+
+    // From the head rightwards, then from the start of the buffer
+    unsigned int right = min(used, capacity - head);
+    iovec segments[2] = {
+        { buffer + head, right },
+        { buffer, used - right }
+    };
+
+    ssize_t count;
+    do {
+        count = writev(fd, segments, segments[1].iov_len ? 2 : 1);
+    } while((count < 0) && (errno == EINTR));
+    if(count < 0) {
+        if((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+            return -1;
+        }
+        throw runtime_error(string("writev: ") + strerror(errno));
+    }
+
+    // Remove from the head, then move the head rightwards and allow it to wrap-around
+    unsigned int removed = min(static_cast<unsigned int>(count), right);
+    fill(buffer + head, buffer + head + removed, ' ');
+    fill(buffer, buffer + (count - removed), ' ');
+    head += count;
+    head %= capacity;
+    used -= count;
+    return count;
 }
 
 int main() {
@@ -275,6 +355,44 @@ int main() {
     cout << buffer2 << endl;
     circular->print();
 
+    // Fill the buffer completely, which head == tail alone cannot tell apart from empty
+    cout << "Fill the buffer completely: ";
+    const char* data3 = "ABCDEFGHIJKLMNOPQR";
+    cout << data3 << endl;
+    circular->write(data3, strlen(data3));
+    circular->print();
+
+    // Write to a file descriptor from the head and wrap-around, in one system call
+    int fds[2];
+    if(pipe(fds) != 0) {
+        cout << "pipe failed" << endl;
+        return 1;
+    }
+    cout << "Write to a pipe from the head and wrap-around: ";
+    ssize_t written = circular->write_to_fd(fds[1]);
+    char piped[21] = {};
+    read(fds[0], piped, sizeof(piped) - 1);
+    cout << written << " bytes, " << piped << endl;
+    circular->print();
+
+    // Read from a file descriptor into the tail, in one system call
+    cout << "Read from a pipe into the tail: ";
+    const char* data4 = "0123456789";
+    write(fds[1], data4, strlen(data4));
+    cout << circular->read_from_fd(fds[0]) << " bytes, " << data4 << endl;
+    circular->print();
+
+    // Read from a non-blocking file descriptor with no data
+    cout << "Read from a pipe with no data: ";
+    fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+    cout << circular->read_from_fd(fds[0]) << endl;
+
+    // Read from a file descriptor at end of file
+    cout << "Read from a pipe at end of file: ";
+    close(fds[1]);
+    cout << circular->read_from_fd(fds[0]) << endl;
+    close(fds[0]);
+
     // Clean-up
     delete circular;
 }
@@ -0,0 +1,197 @@
+// A circular buffer shared by one producer and several consumers, with a
+// benchmark against copying each record into a queue per consumer
+//
+// Usage: disruptor [<records>]
+//
+// A producer sends records (1 << 20 by default) to a parser and a logger, and
+// a metrics stage reads what the parser adds to each record. With the
+// disruptor every stage reads the records in place, and the metrics stage
+// depends on the parser; with queues the producer copies each record into a
+// queue for the parser and one for the logger, and the parser copies it on
+// into a queue for the metrics stage.
+
+#include <chrono>       // For steady_clock
+#include <cstdlib>      // For atoi
+#include <iostream>     // For cout etc
+#include <thread>       // For thread
+#include <vector>       // For vector
+
+#include "disruptor.hpp"
+#include "mpmc.hpp"
+
+using namespace std;
+
+// The most records a queue consumer takes at once
+const size_t BATCH = 64;
+
+// A record, with a field filled in by the parser
+struct Record {
+    size_t id;
+    size_t value;
+    size_t parsed;
+};
+
+// What each stage adds up, to check that every record was seen once
+struct Totals {
+    size_t parser;
+    size_t logger;
+    size_t metrics;
+};
+
+// The totals every run should reach
+Totals expected(size_t total) {
+    Totals totals = { 0, 0, 0 };
+    for(size_t i = 0; i < total; i++) {
+        totals.parser += i * 3;
+        totals.logger += i;
+        totals.metrics += i * 3 + 1;
+    }
+    return totals;
+}
+
+// Print the result of one run
+void report(const char* name, size_t total, chrono::steady_clock::time_point start, const Totals& totals) {
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+    Totals correct = expected(total);
+    cout << name << ": " << total / elapsed.count() / 1e6 << " million records/s, "
+         << ((totals.parser == correct.parser && totals.logger == correct.logger && totals.metrics == correct.metrics) ?
+             "correct" : "incorrect") << endl;
+}
+
+// Fan the records out through one disruptor
+void run_disruptor(size_t total) {
+    Disruptor<Record> ring(1024);
+    size_t parser = ring.add_consumer();
+    size_t logger = ring.add_consumer();
+    size_t metrics = ring.add_consumer({ parser });
+    Totals totals = { 0, 0, 0 };
+
+    auto start = chrono::steady_clock::now();
+    vector<thread> threads;
+    threads.emplace_back([&]() {
+        for(size_t next = 0; next < total; ) {
+            size_t end = ring.wait_for(parser, next);
+            for( ; next < end; next++) {
+                Record& record = ring.at(next);
+                record.parsed = record.value * 3;
+                totals.parser += record.parsed;
+            }
+            ring.release(parser, end);
+        }
+    });
+    threads.emplace_back([&]() {
+        for(size_t next = 0; next < total; ) {
+            size_t end = ring.wait_for(logger, next);
+            for( ; next < end; next++) {
+                totals.logger += ring.at(next).id;
+            }
+            ring.release(logger, end);
+        }
+    });
+    threads.emplace_back([&]() {
+        for(size_t next = 0; next < total; ) {
+            size_t end = ring.wait_for(metrics, next);
+            for( ; next < end; next++) {
+                totals.metrics += ring.at(next).parsed + 1;
+            }
+            ring.release(metrics, end);
+        }
+    });
+
+    for(size_t i = 0; i < total; i++) {
+        size_t position = ring.claim(1);
+        Record& record = ring.at(position);
+        record.id = i;
+        record.value = i;
+        record.parsed = 0;
+        ring.publish(position + 1);
+    }
+    for(thread& t : threads) {
+        t.join();
+    }
+    report("Disruptor", total, start, totals);
+}
+
+// Fan the records out by copying them into a queue per consumer
+void run_queues(size_t total) {
+    MpmcQueue<Record> to_parser(1024);
+    MpmcQueue<Record> to_logger(1024);
+    MpmcQueue<Record> to_metrics(1024);
+    Totals totals = { 0, 0, 0 };
+
+    auto start = chrono::steady_clock::now();
+    vector<thread> threads;
+    threads.emplace_back([&]() {
+        Record records[BATCH];
+        for(size_t done = 0; done < total; ) {
+            size_t count = to_parser.try_pop_n(records, BATCH);
+            if(count == 0) {
+                this_thread::yield();
+            }
+            for(size_t i = 0; i < count; i++) {
+                records[i].parsed = records[i].value * 3;
+                totals.parser += records[i].parsed;
+            }
+            to_metrics.push_n(records, count);
+            done += count;
+        }
+    });
+    threads.emplace_back([&]() {
+        Record records[BATCH];
+        for(size_t done = 0; done < total; ) {
+            size_t count = to_logger.try_pop_n(records, BATCH);
+            if(count == 0) {
+                this_thread::yield();
+            }
+            for(size_t i = 0; i < count; i++) {
+                totals.logger += records[i].id;
+            }
+            done += count;
+        }
+    });
+    threads.emplace_back([&]() {
+        Record records[BATCH];
+        for(size_t done = 0; done < total; ) {
+            size_t count = to_metrics.try_pop_n(records, BATCH);
+            if(count == 0) {
+                this_thread::yield();
+            }
+            for(size_t i = 0; i < count; i++) {
+                totals.metrics += records[i].parsed + 1;
+            }
+            done += count;
+        }
+    });
+
+    for(size_t i = 0; i < total; i++) {
+        Record record = { i, i, 0 };
+        to_parser.push(record);
+        to_logger.push(record);
+    }
+    for(thread& t : threads) {
+        t.join();
+    }
+    report("Queues", total, start, totals);
+}
+
+int main(int argc, char* argv[]) {
+    size_t total = (argc > 1) ? atoi(argv[1]) : 1 << 20;
+    if(total == 0) {
+        cout << "Usage: " << argv[0] << " [<records>]" << endl;
+        return 1;
+    }
+
+    // A consumer cannot depend on one that does not exist yet
+    Disruptor<Record> ring(4);
+    try {
+        ring.add_consumer({ 0 });
+    }
+    catch(exception& e) {
+        cout << e.what() << endl;
+    }
+    cout << "Capacity of a disruptor created for 4 records: " << ring.capacity() << endl;
+
+    cout << "Fanning out " << total << " records to a parser, a logger and metrics:" << endl;
+    run_disruptor(total);
+    run_queues(total);
+}
@@ -0,0 +1,201 @@
+// A circular buffer shared by one producer and several consumers, each of which
+// sees every record, after the LMAX Disruptor
+
+#ifndef DISRUPTOR_H
+#define DISRUPTOR_H
+
+#include <algorithm>    // For min
+#include <atomic>       // For atomic
+#include <cstddef>      // For size_t
+#include <cstdlib>      // For free
+#include <memory>       // For unique_ptr
+#include <new>          // For bad_alloc
+#include <stdexcept>    // For runtime_error
+#include <thread>       // For yield
+#include <vector>       // For vector
+
+#include <stdlib.h>     // For posix_memalign
+
+#include "spsc.hpp"     // For CACHE_LINE, round_up_power_of_2
+
+// Records are written into the buffer once and then read in place by every
+// consumer, instead of being copied into a separate queue for each consumer
+//
+// The producer publishes records by advancing a cursor, and each consumer
+// advances its own sequence as it finishes with them; all of these are
+// free-running counts of records. A consumer may depend on other consumers, in
+// which case it only sees a record after they have all finished with it, so
+// for example a parser can fill in fields of the record that a later stage
+// reads. A slot is only reused once every consumer has passed it, which the
+// producer checks against the consumers that nothing depends on
+//
+// All the consumers must be added before the producer starts. Each consumer
+// is used by one thread, and there is one producer thread
+template<typename T>
+class Disruptor {
+public:
+    Disruptor(size_t n);                                    // constructor - create a buffer to hold at least n records
+    ~Disruptor();                                           // destructor - destroy the buffer
+
+    size_t capacity() const;                                // the number of records the buffer can hold
+    size_t add_consumer(const std::vector<size_t>& dependencies = std::vector<size_t>());  // add a consumer, returning its id
+
+    T& at(size_t position);                                 // the record at a free-running position
+
+    // Producer only
+    size_t claim(size_t nelements);                         // wait for room for nelements records, returning the position of the first
+    void publish(size_t end);                               // make the records before end visible to the consumers
+
+    // Consumer only
+    size_t wait_for(size_t consumer, size_t position);      // wait for the record at position, returning the end of the records available
+    void release(size_t consumer, size_t end);              // finish with the records before end
+
+private:
+    Disruptor(const Disruptor&) = delete;
+    Disruptor& operator=(const Disruptor&) = delete;
+
+    // A count of records, on a cache line of its own. Before C++17 new does
+    // not honour the alignment by itself, so Sequence allocates its own
+    struct alignas(CACHE_LINE) Sequence {
+        std::atomic<size_t> value;
+
+        Sequence() : value(0) {}
+
+        static void* operator new(size_t size) {
+            void* memory = nullptr;
+            if(posix_memalign(&memory, CACHE_LINE, size) != 0) {
+                throw std::bad_alloc();
+            }
+            return memory;
+        }
+        static void operator delete(void* memory) { free(memory); }
+    };
+
+    static void backoff(unsigned int& spins);               // spin for a while, then yield to other threads
+    size_t gate() const;                                    // the fewest records any consumer has finished with
+
+    const size_t mask;
+    T* const records;
+    Sequence cursor;                                        // records published by the producer
+    size_t claimed;                                         // producer only - records claimed by the producer
+    size_t gated;                                           // producer only - the last value of gate()
+
+    std::vector<std::unique_ptr<Sequence>> sequences;       // records finished with by each consumer
+    std::vector<std::vector<size_t>> dependencies;          // the consumers each consumer waits for
+    std::vector<bool> gating;                               // whether the producer waits for each consumer
+};
+
+// Constructor - create a buffer to hold at least n records, rounded up to a power of 2
+template<typename T>
+Disruptor<T>::Disruptor(size_t n)
+    : mask(round_up_power_of_2(n ? n : 1) - 1), records(new T[mask + 1]), cursor(), claimed(0), gated(0) {
+}
+
+// Destructor - destroy the buffer
+template<typename T>
+Disruptor<T>::~Disruptor() {
+    delete[] records;
+}
+
+// The number of records the buffer can hold
+template<typename T>
+size_t Disruptor<T>::capacity() const {
+    return mask + 1;
+}
+
+// Add a consumer that only sees records after the consumers it depends on,
+// returning its id
+template<typename T>
+size_t Disruptor<T>::add_consumer(const std::vector<size_t>& depends_on) {
+    for(size_t dependency : depends_on) {
+        if(dependency >= sequences.size()) {
+            throw std::runtime_error("Bad arguments");
+        }
+        gating[dependency] = false;     // the new consumer is always behind it
+    }
+
+    sequences.emplace_back(new Sequence());
+    dependencies.push_back(depends_on);
+    gating.push_back(true);
+    return sequences.size() - 1;
+}
+
+// The record at a free-running position
+template<typename T>
+T& Disruptor<T>::at(size_t position) {
+    return records[position & mask];
+}
+
+// Spin for a while, then yield to other threads
+template<typename T>
+void Disruptor<T>::backoff(unsigned int& spins) {
+    if(++spins > 64) {
+        std::this_thread::yield();
+    }
+}
+
+// The fewest records any consumer has finished with
+template<typename T>
+size_t Disruptor<T>::gate() const {
+    size_t minimum = claimed;
+    for(size_t i = 0; i < sequences.size(); i++) {
+        if(gating[i]) {
+            minimum = std::min(minimum, sequences[i]->value.load(std::memory_order_acquire));
+        }
+    }
+    return minimum;
+}
+
+// Wait for room for nelements records, returning the position of the first
+//
+// The slowest consumer is only looked up again when the last one seen says
+// there is not enough room
+template<typename T>
+size_t Disruptor<T>::claim(size_t nelements) {
+    if((nelements == 0) || (nelements > capacity())) {
+        throw std::runtime_error("Bad arguments");
+    }
+
+    size_t end = claimed + nelements;
+    unsigned int spins = 0;
+    while(end - gated > capacity()) {
+        gated = gate();
+        if(end - gated > capacity()) {
+            backoff(spins);
+        }
+    }
+    claimed = end;
+    return end - nelements;
+}
+
+// Make the records before end visible to the consumers
+template<typename T>
+void Disruptor<T>::publish(size_t end) {
+    cursor.value.store(end, std::memory_order_release);
+}
+
+// Wait for the record at position, returning the end of the records available
+// to the consumer, which may all be processed as a batch
+template<typename T>
+size_t Disruptor<T>::wait_for(size_t consumer, size_t position) {
+    const std::vector<size_t>& barrier = dependencies[consumer];
+    unsigned int spins = 0;
+    for(;;) {
+        size_t available = cursor.value.load(std::memory_order_acquire);
+        for(size_t dependency : barrier) {
+            available = std::min(available, sequences[dependency]->value.load(std::memory_order_acquire));
+        }
+        if(available > position) {
+            return available;
+        }
+        backoff(spins);
+    }
+}
+
+// Finish with the records before end
+template<typename T>
+void Disruptor<T>::release(size_t consumer, size_t end) {
+    sequences[consumer]->value.store(end, std::memory_order_release);
+}
+
+#endif
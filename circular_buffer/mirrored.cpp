@@ -0,0 +1,64 @@
+// A circular buffer of bytes whose memory is mapped twice, back to back, so
+// that reads and writes never have to be split at the wrap point
+
+#include <cstring>      // For strlen
+#include <iostream>     // For cout etc
+#include <string>       // For string
+
+#include "mirrored.hpp"
+
+using namespace std;
+
+int main() {
+    // Create a mirrored buffer
+    MirroredCircular mirrored(100);
+    cout << "Capacity of a buffer created for 100 bytes: " << mirrored.capacity() << endl;
+
+    // Fill most of the buffer and empty it again, to leave the head near the end
+    string filler(mirrored.capacity() - 10, '.');
+    mirrored.write(filler.data(), filler.size());
+    string drained(filler.size(), ' ');
+    mirrored.read(&drained[0], drained.size());
+    cout << "Head moved to within 10 bytes of the end, size is " << mirrored.size() << endl;
+
+    // Write many at a time to the tail and wrap-around, in one copy
+    const char* data = "abcdefghijklmnopqrstuvwxyz";
+    mirrored.write(data, strlen(data));
+    cout << "Wrote " << strlen(data) << " bytes across the wrap point, size is " << mirrored.size() << endl;
+
+    // The data that wrapped around is still contiguous at the read pointer
+    cout << "Read pointer: " << string(mirrored.read_pointer(), mirrored.size()) << endl;
+
+    // Consume part of it in place without copying
+    mirrored.consume(13);
+    cout << "Consumed 13 bytes in place, read pointer: " << string(mirrored.read_pointer(), mirrored.size()) << endl;
+
+    // Fill the write pointer directly without copying
+    char* space = mirrored.write_pointer();
+    for(int i = 0; i < 10; i++) {
+        space[i] = '0' + i;
+    }
+    mirrored.produce(10);
+    cout << "Produced 10 bytes in place, read pointer: " << string(mirrored.read_pointer(), mirrored.size()) << endl;
+
+    // Read many at a time from the head
+    char buffer[24] {};
+    mirrored.read(buffer, 23);
+    cout << "Read 23 bytes: " << buffer << endl;
+    cout << "Empty: " << boolalpha << mirrored.empty() << endl;
+
+    // Invalid operations
+    try {
+        mirrored.read(buffer, 1);
+    }
+    catch(exception& e) {
+        cout << e.what() << endl;
+    }
+    try {
+        string too_much(mirrored.capacity() + 1, 'x');
+        mirrored.write(too_much.data(), too_much.size());
+    }
+    catch(exception& e) {
+        cout << e.what() << endl;
+    }
+}
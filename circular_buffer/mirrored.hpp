@@ -0,0 +1,174 @@
+// A circular buffer of bytes whose memory is mapped twice, back to back, so
+// that every read or write is one contiguous region (Linux only)
+
+#ifndef MIRRORED_H
+#define MIRRORED_H
+
+#include <cerrno>       // For errno
+#include <cstddef>      // For size_t
+#include <cstring>      // For memcpy, strerror
+#include <stdexcept>    // For runtime_error
+#include <string>       // For string
+
+#include <sys/mman.h>   // For memfd_create, mmap, munmap
+#include <unistd.h>     // For close, ftruncate, sysconf
+
+// The same physical pages appear at buffer[0..capacity) and again at
+// buffer[capacity..2*capacity), so data that wraps around the end of the buffer
+// is still contiguous in memory. Reads and writes are then a single copy with
+// no split at the wrap point, and callers can be handed pointers straight into
+// the buffer instead of copying at all
+//
+// Like Circular this is not thread-safe
+class MirroredCircular {
+public:
+    MirroredCircular(size_t n);                             // constructor - create a buffer to hold at least n bytes
+    ~MirroredCircular();                                    // destructor - destroy the buffer
+
+    size_t available() const;                               // the number of unused bytes available in the buffer
+    size_t capacity() const;                                // the number of bytes the buffer can hold
+    bool empty() const;                                     // is the buffer empty?
+    size_t size() const;                                    // the number of used bytes currently in the buffer
+
+    void read(char* data, size_t nelements);                // read many at a time from the head of the buffer
+    void write(const char* data, size_t nelements);         // write many at a time to the tail of the buffer
+
+    const char* read_pointer() const;                       // the size() used bytes at the head, contiguous
+    void consume(size_t nelements);                         // remove bytes from the head after using read_pointer()
+    char* write_pointer();                                  // the available() unused bytes at the tail, contiguous
+    void produce(size_t nelements);                         // add bytes at the tail after filling write_pointer()
+
+private:
+    MirroredCircular(const MirroredCircular&) = delete;
+    MirroredCircular& operator=(const MirroredCircular&) = delete;
+
+    size_t head;                                            // always in [0, capacity)
+    size_t used;
+    size_t length;                                          // capacity, a whole number of pages
+    char* buffer;                                           // 2*capacity bytes of address space
+};
+
+// Constructor - create a buffer to hold at least n bytes, rounded up to a whole number of pages
+inline MirroredCircular::MirroredCircular(size_t n) : head(0), used(0), length(0), buffer(nullptr) {
+    size_t page = sysconf(_SC_PAGESIZE);
+    length = ((n ? n : 1) + page - 1) / page * page;
+
+    // The pages to be mapped twice live in an anonymous file
+    int fd = memfd_create("MirroredCircular", 0);
+    if(fd < 0) {
+        throw std::runtime_error(std::string("memfd_create: ") + std::strerror(errno));
+    }
+    if(ftruncate(fd, length) != 0) {
+        int error = errno;
+        close(fd);
+        throw std::runtime_error(std::string("ftruncate: ") + std::strerror(error));
+    }
+
+    // Reserve enough address space for both copies, then map the file over
+    // each half of it
+    void* reserved = mmap(nullptr, 2 * length, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(reserved == MAP_FAILED) {
+        int error = errno;
+        close(fd);
+        throw std::runtime_error(std::string("mmap: ") + std::strerror(error));
+    }
+    buffer = static_cast<char*>(reserved);
+
+    for(size_t offset = 0; offset < 2 * length; offset += length) {
+        void* mapped = mmap(buffer + offset, length, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0);
+        if(mapped == MAP_FAILED) {
+            int error = errno;
+            munmap(buffer, 2 * length);
+            close(fd);
+            throw std::runtime_error(std::string("mmap: ") + std::strerror(error));
+        }
+    }
+
+    // The mappings keep the file alive
+    close(fd);
+}
+
+// Destructor - destroy the buffer
+inline MirroredCircular::~MirroredCircular() {
+    munmap(buffer, 2 * length);
+}
+
+// The number of unused bytes available in the buffer
+inline size_t MirroredCircular::available() const {
+    return length - used;
+}
+
+// The number of bytes the buffer can hold
+inline size_t MirroredCircular::capacity() const {
+    return length;
+}
+
+// Is the buffer empty?
+inline bool MirroredCircular::empty() const {
+    return used == 0;
+}
+
+// The number of used bytes currently in the buffer
+inline size_t MirroredCircular::size() const {
+    return used;
+}
+
+// Read many at a time from the head of the buffer
+inline void MirroredCircular::read(char* data, size_t nelements) {
+    if((data == nullptr) || (nelements == 0)) {
+        throw std::runtime_error("Bad arguments");
+    }
+    if(used < nelements) {
+        throw std::runtime_error("Invalid operation: not enough data to read");
+    }
+
+    std::memcpy(data, read_pointer(), nelements);
+    consume(nelements);
+}
+
+// Write many at a time to the tail of the buffer
+inline void MirroredCircular::write(const char* data, size_t nelements) {
+    if((data == nullptr) || (nelements == 0)) {
+        throw std::runtime_error("Bad arguments");
+    }
+    if(available() < nelements) {
+        throw std::runtime_error("Invalid operation: not enough space to write");
+    }
+
+    std::memcpy(write_pointer(), data, nelements);
+    produce(nelements);
+}
+
+// The size() used bytes at the head, contiguous even if they wrap around
+inline const char* MirroredCircular::read_pointer() const {
+    return buffer + head;
+}
+
+// Remove bytes from the head after using read_pointer()
+inline void MirroredCircular::consume(size_t nelements) {
+    if(used < nelements) {
+        throw std::runtime_error("Invalid operation: not enough data to consume");
+    }
+
+    // Move the head rightwards and allow it to wrap-around, without a %
+    head += nelements;
+    if(head >= length) {
+        head -= length;
+    }
+    used -= nelements;
+}
+
+// The available() unused bytes at the tail, contiguous even if they wrap around
+inline char* MirroredCircular::write_pointer() {
+    return buffer + head + used;
+}
+
+// Add bytes at the tail after filling write_pointer()
+inline void MirroredCircular::produce(size_t nelements) {
+    if(available() < nelements) {
+        throw std::runtime_error("Invalid operation: not enough space to produce");
+    }
+    used += nelements;
+}
+
+#endif
@@ -0,0 +1,141 @@
+// A bounded multi-producer/multi-consumer queue, with a benchmark of how it
+// behaves under contention
+//
+// Usage: mpmc [<max threads>]
+//
+// Runs every combination of 1, 2, 4, ... up to max threads (64 by default)
+// producers and consumers, checks that every element pushed is popped exactly
+// once, and reports the throughput in millions of elements per second, or
+// incorrect if any element was lost or duplicated.
+
+#include <atomic>       // For atomic
+#include <chrono>       // For steady_clock
+#include <cstdlib>      // For atoi
+#include <iomanip>      // For setw
+#include <iostream>     // For cout etc
+#include <memory>       // For unique_ptr
+#include <sstream>      // For ostringstream
+#include <string>       // For string
+#include <thread>       // For thread
+#include <vector>       // For vector
+
+#include "mpmc.hpp"
+
+using namespace std;
+
+// Total number of elements passed through the queue for each combination, in
+// batches of BATCH for the batched runs
+const size_t TOTAL = 1 << 18;
+const size_t BATCH = 16;
+
+// Pass TOTAL elements from producers to consumers, returning millions of
+// elements per second and setting correct if every element was popped exactly
+// once
+double contend(unsigned int producers, unsigned int consumers, bool batched, bool& correct) {
+    MpmcQueue<size_t> queue(1024);
+    atomic<size_t> popped(0);
+    vector<atomic<unsigned int>> counts(TOTAL + 1);   // how many times each of 1..TOTAL was popped
+    for(atomic<unsigned int>& count : counts) {
+        count.store(0, memory_order_relaxed);
+    }
+    vector<thread> threads;
+
+    auto start = chrono::steady_clock::now();
+    for(unsigned int p = 0; p < producers; p++) {
+        threads.emplace_back([&, p]() {
+            // Each producer pushes its share of 1..TOTAL
+            size_t values[BATCH];
+            size_t count = 0;
+            for(size_t value = p + 1; value <= TOTAL; value += producers) {
+                if(!batched) {
+                    queue.push(value);
+                    continue;
+                }
+                values[count++] = value;
+                if(count == BATCH) {
+                    queue.push_n(values, count);
+                    count = 0;
+                }
+            }
+            queue.push_n(values, count);
+        });
+    }
+    for(unsigned int c = 0; c < consumers; c++) {
+        threads.emplace_back([&]() {
+            size_t values[BATCH];
+            while(popped.load(memory_order_relaxed) < TOTAL) {
+                size_t count = batched ? queue.try_pop_n(values, BATCH) : queue.try_pop(values[0]);
+                if(count == 0) {
+                    this_thread::yield();
+                    continue;
+                }
+                for(size_t i = 0; i < count; i++) {
+                    if(values[i] <= TOTAL) {
+                        counts[values[i]].fetch_add(1, memory_order_relaxed);
+                    }
+                }
+                popped.fetch_add(count, memory_order_relaxed);
+            }
+        });
+    }
+    for(thread& t : threads) {
+        t.join();
+    }
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+
+    // The threads have been joined, so the counts are all visible
+    correct = (popped.load() == TOTAL);
+    for(size_t value = 1; correct && (value <= TOTAL); value++) {
+        correct = (counts[value].load(memory_order_relaxed) == 1);
+    }
+    return TOTAL / elapsed.count() / 1e6;
+}
+
+// One cell of the contention table, the throughput or incorrect
+string cell(double throughput, bool correct) {
+    ostringstream text;
+    text << fixed << setprecision(2) << throughput;
+    return correct ? text.str() : "incorrect";
+}
+
+int main(int argc, char* argv[]) {
+    unsigned int max_threads = (argc > 1) ? atoi(argv[1]) : 64;
+
+    // Single-threaded use
+    MpmcQueue<string> queue(3);
+    cout << "Capacity of a queue created for 3 elements: " << queue.capacity() << endl;
+    for(const char* word : { "one", "two", "three", "four", "five" }) {
+        cout << "Push " << word << ": " << boolalpha << queue.try_push(word) << endl;
+    }
+    string word;
+    while(queue.try_pop(word)) {
+        cout << "Pop " << word << endl;
+    }
+    cout << "Pop from an empty queue: " << queue.try_pop(word) << endl;
+
+    // Move-only elements
+    MpmcQueue<unique_ptr<int>> pointers(2);
+    pointers.push(unique_ptr<int>(new int(42)));
+    unique_ptr<int> pointer;
+    pointers.pop(pointer);
+    cout << "Pop a move-only element: " << *pointer << endl;
+    cout << endl;
+
+    // Contention
+    cout << "Millions of elements per second, single and batches of " << BATCH << ":" << endl;
+    cout << setw(10) << "Producers" << setw(10) << "Consumers" << setw(10) << "Single" << setw(10) << "Batched" << endl;
+    bool all_correct = true;
+    for(unsigned int producers = 1; producers <= max_threads; producers *= 2) {
+        for(unsigned int consumers = 1; consumers <= max_threads; consumers *= 2) {
+            bool single_correct = false;
+            bool batched_correct = false;
+            double single = contend(producers, consumers, false, single_correct);
+            double batched = contend(producers, consumers, true, batched_correct);
+            cout << setw(10) << producers << setw(10) << consumers
+                 << setw(10) << cell(single, single_correct) << setw(10) << cell(batched, batched_correct) << endl;
+            all_correct = all_correct && single_correct && batched_correct;
+        }
+    }
+    cout << "Every element popped exactly once: " << (all_correct ? "correct" : "incorrect") << endl;
+    return all_correct ? 0 : 1;
+}
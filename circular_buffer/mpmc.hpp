@@ -0,0 +1,270 @@
+// A bounded lock-free multi-producer/multi-consumer queue using a circular
+// buffer, after Dmitry Vyukov's design
+
+#ifndef MPMC_H
+#define MPMC_H
+
+#include <atomic>       // For atomic
+#include <cstddef>      // For size_t
+#include <thread>       // For yield
+#include <utility>      // For move
+
+#include "spsc.hpp"     // For CACHE_LINE, round_up_power_of_2
+
+// Any number of threads may push and pop at the same time
+//
+// Each cell has a sequence number saying whose turn it is: a cell at position
+// pos is free for the producer that claims pos when its sequence is pos, and
+// holds data for the consumer that claims pos when its sequence is pos + 1.
+// Producers and consumers claim positions with a compare-and-swap on their own
+// counter and then hand the cell over by storing the next sequence number, so
+// a slow thread only holds up the cell it claimed
+template<typename T>
+class MpmcQueue {
+public:
+    MpmcQueue(size_t n);                        // constructor - create a queue to hold at least n elements
+    ~MpmcQueue();                               // destructor - destroy the queue
+
+    size_t capacity() const;                    // the number of elements the queue can hold
+
+    bool try_push(const T& value);              // push one element if there is room
+    bool try_push(T&& value);                   // push one element if there is room
+    bool try_pop(T& value);                     // pop one element if there is one
+    void push(const T& value);                  // push one element, waiting for room
+    void push(T&& value);                       // push one element, waiting for room
+    void pop(T& value);                         // pop one element, waiting for one
+
+    size_t try_push_n(const T* values, size_t n);   // push up to n elements with one claim, returning how many were pushed
+    size_t try_pop_n(T* values, size_t n);          // pop up to n elements with one claim, returning how many were popped
+    void push_n(const T* values, size_t n);         // push n elements, waiting for room
+    void pop_n(T* values, size_t n);                // pop n elements, waiting for them
+
+private:
+    MpmcQueue(const MpmcQueue&) = delete;
+    MpmcQueue& operator=(const MpmcQueue&) = delete;
+
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T data;
+    };
+
+    template<typename U>
+    bool try_push_one(U&& value);
+
+    static void backoff(unsigned int& spins);   // spin for a while, then yield to other threads
+
+    Cell* const cells;
+    const size_t mask;
+
+    // Each counter on a cache line of its own, apart from the read-only fields
+    alignas(CACHE_LINE) std::atomic<size_t> enqueue_pos;    // next position to push, shared by producers
+    alignas(CACHE_LINE) std::atomic<size_t> dequeue_pos;    // next position to pop, shared by consumers
+};
+
+// Constructor - create a queue to hold at least n elements, rounded up to a power of 2
+template<typename T>
+MpmcQueue<T>::MpmcQueue(size_t n)
+    : cells(new Cell[round_up_power_of_2(n ? n : 1)]), mask(round_up_power_of_2(n ? n : 1) - 1),
+      enqueue_pos(0), dequeue_pos(0) {
+    for(size_t i = 0; i <= mask; i++) {
+        cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+// Destructor - destroy the queue
+template<typename T>
+MpmcQueue<T>::~MpmcQueue() {
+    delete[] cells;
+}
+
+// The number of elements the queue can hold
+template<typename T>
+size_t MpmcQueue<T>::capacity() const {
+    return mask + 1;
+}
+
+// Spin for a while, then yield to other threads
+template<typename T>
+void MpmcQueue<T>::backoff(unsigned int& spins) {
+    if(++spins > 64) {
+        std::this_thread::yield();
+    }
+}
+
+// Push one element if there is room
+template<typename T>
+template<typename U>
+bool MpmcQueue<T>::try_push_one(U&& value) {
+    size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+    for(;;) {
+        Cell& cell = cells[pos & mask];
+        size_t sequence = cell.sequence.load(std::memory_order_acquire);
+        if(sequence == pos) {
+            // The cell is free, try to claim it
+            if(enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                cell.data = std::forward<U>(value);
+                cell.sequence.store(pos + 1, std::memory_order_release);
+                return true;
+            }
+        }
+        else if(sequence < pos) {
+            // The cell still holds the element from one lap ago, so the queue is full
+            return false;
+        }
+        else {
+            // Another producer claimed this position first
+            pos = enqueue_pos.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+template<typename T>
+bool MpmcQueue<T>::try_push(const T& value) {
+    return try_push_one(value);
+}
+
+template<typename T>
+bool MpmcQueue<T>::try_push(T&& value) {
+    return try_push_one(std::move(value));
+}
+
+// Pop one element if there is one
+template<typename T>
+bool MpmcQueue<T>::try_pop(T& value) {
+    size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+    for(;;) {
+        Cell& cell = cells[pos & mask];
+        size_t sequence = cell.sequence.load(std::memory_order_acquire);
+        if(sequence == pos + 1) {
+            // The cell holds data, try to claim it
+            if(dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                value = std::move(cell.data);
+                cell.sequence.store(pos + mask + 1, std::memory_order_release);
+                return true;
+            }
+        }
+        else if(sequence < pos + 1) {
+            // Nothing has been pushed at this position yet, so the queue is empty
+            return false;
+        }
+        else {
+            // Another consumer claimed this position first
+            pos = dequeue_pos.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+// Push one element, waiting for room
+template<typename T>
+void MpmcQueue<T>::push(const T& value) {
+    unsigned int spins = 0;
+    while(!try_push_one(value)) {
+        backoff(spins);
+    }
+}
+
+template<typename T>
+void MpmcQueue<T>::push(T&& value) {
+    unsigned int spins = 0;
+    while(!try_push_one(std::move(value))) {
+        backoff(spins);
+    }
+}
+
+// Pop one element, waiting for one
+template<typename T>
+void MpmcQueue<T>::pop(T& value) {
+    unsigned int spins = 0;
+    while(!try_pop(value)) {
+        backoff(spins);
+    }
+}
+
+// Push up to n elements with one claim, returning how many were pushed
+//
+// The run of consecutive free cells is counted first, then claimed all at once,
+// which no other producer can have taken since their sequence numbers were read
+template<typename T>
+size_t MpmcQueue<T>::try_push_n(const T* values, size_t n) {
+    size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+    for(;;) {
+        size_t count = 0;
+        while(count < n && cells[(pos + count) & mask].sequence.load(std::memory_order_acquire) == pos + count) {
+            count++;
+        }
+        if(count == 0) {
+            size_t sequence = cells[pos & mask].sequence.load(std::memory_order_acquire);
+            if(sequence < pos || n == 0) {
+                return 0;
+            }
+            pos = enqueue_pos.load(std::memory_order_relaxed);
+            continue;
+        }
+
+        if(enqueue_pos.compare_exchange_weak(pos, pos + count, std::memory_order_relaxed)) {
+            for(size_t i = 0; i < count; i++) {
+                Cell& cell = cells[(pos + i) & mask];
+                cell.data = values[i];
+                cell.sequence.store(pos + i + 1, std::memory_order_release);
+            }
+            return count;
+        }
+    }
+}
+
+// Pop up to n elements with one claim, returning how many were popped
+template<typename T>
+size_t MpmcQueue<T>::try_pop_n(T* values, size_t n) {
+    size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+    for(;;) {
+        size_t count = 0;
+        while(count < n && cells[(pos + count) & mask].sequence.load(std::memory_order_acquire) == pos + count + 1) {
+            count++;
+        }
+        if(count == 0) {
+            size_t sequence = cells[pos & mask].sequence.load(std::memory_order_acquire);
+            if(sequence < pos + 1 || n == 0) {
+                return 0;
+            }
+            pos = dequeue_pos.load(std::memory_order_relaxed);
+            continue;
+        }
+
+        if(dequeue_pos.compare_exchange_weak(pos, pos + count, std::memory_order_relaxed)) {
+            for(size_t i = 0; i < count; i++) {
+                Cell& cell = cells[(pos + i) & mask];
+                values[i] = std::move(cell.data);
+                cell.sequence.store(pos + i + mask + 1, std::memory_order_release);
+            }
+            return count;
+        }
+    }
+}
+
+// Push n elements, waiting for room
+template<typename T>
+void MpmcQueue<T>::push_n(const T* values, size_t n) {
+    unsigned int spins = 0;
+    for(size_t done = 0; done < n; ) {
+        size_t count = try_push_n(values + done, n - done);
+        if(count == 0) {
+            backoff(spins);
+        }
+        done += count;
+    }
+}
+
+// Pop n elements, waiting for them
+template<typename T>
+void MpmcQueue<T>::pop_n(T* values, size_t n) {
+    unsigned int spins = 0;
+    for(size_t done = 0; done < n; ) {
+        size_t count = try_pop_n(values + done, n - done);
+        if(count == 0) {
+            backoff(spins);
+        }
+        done += count;
+    }
+}
+
+#endif
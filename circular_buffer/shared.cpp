@@ -0,0 +1,184 @@
+// A circular buffer of bytes in POSIX shared memory, so that two processes can
+// exchange data without copying it through the kernel
+//
+// A parent process streams data to an unrelated process that attaches to the
+// shared buffer by name, first through the shared buffer and then through a
+// pipe for comparison
+
+#include <algorithm>    // For min
+#include <chrono>       // For steady_clock
+#include <cstdlib>      // For exit
+#include <cstring>      // For strcmp
+#include <stdexcept>    // For runtime_error
+#include <iostream>     // For cout etc
+#include <string>       // For string, to_string
+#include <thread>       // For this_thread::sleep_for
+#include <vector>       // For vector
+
+#include <sys/wait.h>   // For waitpid
+#include <unistd.h>     // For execl, fork, pipe, read, write
+
+#include "shared.hpp"
+
+using namespace std;
+
+const size_t TOTAL = 256 * 1024 * 1024;
+const size_t CHUNK = 4096;
+
+// The byte at a position in the stream
+char pattern(size_t i) {
+    return static_cast<char>(i * 7 + (i >> 12));
+}
+
+// Fill a chunk of the stream
+void fill(vector<char>& chunk, size_t start, size_t n) {
+    for(size_t j = 0; j < n; j++) {
+        chunk[j] = pattern(start + j);
+    }
+}
+
+// Check a chunk of the stream
+bool check(const vector<char>& chunk, size_t start, size_t n) {
+    bool correct = true;
+    for(size_t j = 0; j < n; j++) {
+        correct = correct && (chunk[j] == pattern(start + j));
+    }
+    return correct;
+}
+
+// Wait for the child and report the throughput
+void report(const string& name, pid_t child, chrono::steady_clock::time_point start) {
+    int status = 0;
+    waitpid(child, &status, 0);
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+    cout << name << ": " << TOTAL / elapsed.count() / 1e6 << " MB/s, "
+         << ((WIFEXITED(status) && WEXITSTATUS(status) == 0) ? "correct" : "incorrect") << endl;
+}
+
+// Wait for the consumer in the child to read from the buffer, returning false
+// if the child exits first, e.g. because exec failed
+//
+// Until the consumer has read, push() has no process id to check, so would
+// wait forever on a full buffer for a consumer that never started
+bool wait_for_consumer(const SharedCircular& shared, pid_t child) {
+    while(!shared.has_consumer()) {
+        int status = 0;
+        if(waitpid(child, &status, WNOHANG) != 0) {
+            return false;
+        }
+        this_thread::sleep_for(chrono::milliseconds(1));
+    }
+    return true;
+}
+
+// The consumer, in a process started with exec rather than a copy of the
+// parent, so that it shares nothing with the producer but the buffer's name
+int consume(const char* name) {
+    SharedCircular shared(name);
+    vector<char> chunk(CHUNK);
+    bool correct = true;
+    for(size_t i = 0; i < TOTAL; i += CHUNK) {
+        shared.pop(chunk.data(), CHUNK);
+        correct = correct && check(chunk, i, CHUNK);
+    }
+    return correct ? 0 : 1;
+}
+
+int main(int argc, char* argv[]) {
+    if((argc == 3) && (strcmp(argv[1], "--consumer") == 0)) {
+        return consume(argv[2]);
+    }
+
+    string name = "/circular_buffer_shared." + to_string(getpid());
+    SharedCircular shared(name.c_str(), 1 << 16);
+    cout << "Capacity of a shared buffer created for 65536 bytes: " << shared.capacity() << endl;
+
+    // A consumer that exits without reading, as when exec fails, should be
+    // reported rather than waited for
+    pid_t child = fork();
+    if(child < 0) {
+        cout << "fork failed" << endl;
+        return 1;
+    }
+    if(child == 0) {
+        _exit(1);
+    }
+    cout << "Waiting for a consumer that exits without reading: "
+         << (wait_for_consumer(shared, child) ? "consumer read, incorrect" : "exited, correct") << endl;
+
+    cout << "Streaming " << TOTAL / (1024 * 1024) << "MB from a parent process to an unrelated process" << endl;
+
+    auto start = chrono::steady_clock::now();
+    child = fork();
+    if(child < 0) {
+        cout << "fork failed" << endl;
+        return 1;
+    }
+    if(child == 0) {
+        execl("/proc/self/exe", argv[0], "--consumer", name.c_str(), static_cast<char*>(nullptr));
+        _exit(1);
+    }
+
+    // The parent is the producer, once the consumer has started
+    if(!wait_for_consumer(shared, child)) {
+        cout << "The consumer exited before reading" << endl;
+        return 1;
+    }
+    vector<char> chunk(CHUNK);
+    for(size_t i = 0; i < TOTAL; i += CHUNK) {
+        fill(chunk, i, CHUNK);
+        shared.push(chunk.data(), CHUNK);
+    }
+    report("Shared memory", child, start);
+
+    // The consumer has gone, so filling the buffer should fail rather than hang
+    vector<char> overfill(shared.capacity() + 1);
+    try {
+        shared.push(overfill.data(), overfill.size());
+        cout << "Pushing to a buffer whose consumer has exited: no error, incorrect" << endl;
+    }
+    catch(const runtime_error& error) {
+        cout << "Pushing to a buffer whose consumer has exited: " << error.what() << ", correct" << endl;
+    }
+
+    // The same through a pipe, which copies into and out of the kernel
+    int fds[2];
+    if(pipe(fds) != 0) {
+        cout << "pipe failed" << endl;
+        return 1;
+    }
+    start = chrono::steady_clock::now();
+    child = fork();
+    if(child < 0) {
+        cout << "fork failed" << endl;
+        return 1;
+    }
+    if(child == 0) {
+        close(fds[1]);
+        bool correct = true;
+        for(size_t i = 0; i < TOTAL; ) {
+            ssize_t count = read(fds[0], chunk.data(), min(CHUNK, TOTAL - i));
+            if(count <= 0) {
+                exit(1);
+            }
+            correct = correct && check(chunk, i, count);
+            i += count;
+        }
+        exit(correct ? 0 : 1);
+    }
+
+    close(fds[0]);
+    for(size_t i = 0; i < TOTAL; i += CHUNK) {
+        fill(chunk, i, CHUNK);
+        for(size_t done = 0; done < CHUNK; ) {
+            ssize_t count = write(fds[1], chunk.data() + done, CHUNK - done);
+            if(count <= 0) {
+                cout << "write failed" << endl;
+                return 1;
+            }
+            done += count;
+        }
+    }
+    close(fds[1]);
+    report("Pipe", child, start);
+}
@@ -0,0 +1,364 @@
+// A circular buffer of bytes in POSIX shared memory, so that two processes can
+// exchange data without copying it through the kernel (Linux only)
+
+#ifndef SHARED_H
+#define SHARED_H
+
+#include <algorithm>    // For min
+#include <atomic>       // For atomic, atomic_thread_fence
+#include <cerrno>       // For errno
+#include <cstddef>      // For size_t
+#include <cstdint>      // For uint32_t
+#include <cstring>      // For memcpy, strerror
+#include <new>          // For placement new
+#include <stdexcept>    // For runtime_error
+#include <string>       // For string
+
+#include <fcntl.h>          // For O_CREAT etc
+#include <linux/futex.h>    // For FUTEX_WAIT, FUTEX_WAKE
+#include <signal.h>         // For kill
+#include <sys/mman.h>       // For mmap, munmap, shm_open, shm_unlink
+#include <sys/stat.h>       // For fstat
+#include <sys/syscall.h>    // For SYS_futex
+#include <time.h>           // For timespec
+#include <unistd.h>         // For close, ftruncate, getpid, syscall
+
+#include "spsc.hpp"     // For CACHE_LINE, round_up_power_of_2
+
+static_assert(ATOMIC_LONG_LOCK_FREE == 2, "atomics in shared memory must be lock-free");
+static_assert(ATOMIC_INT_LOCK_FREE == 2, "atomics in shared memory must be lock-free");
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "a futex must be a plain 32 bit word");
+
+// One process (the producer) writes to the buffer while another process (the
+// consumer) reads from it. One process creates the buffer under a name and any
+// other process may attach to it by that name, whether or not they are related
+//
+// Everything in shared memory is position-independent: the header holds only
+// counters, flags, sizes and process ids, never pointers or file descriptors,
+// and the data follows the header, so the region may be mapped at a different
+// address in each process. head and tail are free-running counters, as in
+// SpscCircular, and each data copy goes straight from the writer's memory into
+// shared memory and out again instead of into and out of a pipe's kernel buffer
+//
+// When the buffer is empty or full, push() and pop() sleep on a futex, a word
+// in the header that the kernel can wait on in every process that maps it. A
+// side only sets its waiting flag just before sleeping, and the other side only
+// makes the wake system call if it sees the flag, so in the steady state no
+// system calls are made at all
+//
+// Each side records its process id in the header the first time it reads or
+// writes. A sleeper wakes up every POLL_INTERVAL to check that the other side's
+// process still exists, and throws rather than waiting forever if it has gone.
+// A side that has not read or written yet cannot be checked, so a process that
+// starts the other side should wait for has_consumer() or has_producer() while
+// checking that it has not failed to start
+class SharedCircular {
+public:
+    SharedCircular(const char* name, size_t n);             // constructor - create a named buffer to hold at least n bytes
+    explicit SharedCircular(const char* name);              // constructor - attach to a buffer another process created
+    ~SharedCircular();                                      // destructor - unmap the buffer, and remove it in the creating process
+
+    size_t available() const;                               // the number of unused bytes available in the buffer
+    size_t capacity() const;                                // the number of bytes the buffer can hold
+    bool empty() const;                                     // is the buffer empty?
+    bool has_consumer() const;                              // has a consumer read from the buffer yet?
+    bool has_producer() const;                              // has a producer written to the buffer yet?
+    size_t size() const;                                    // the number of used bytes currently in the buffer
+
+    size_t read(char* data, size_t nelements);              // consumer only - read up to nelements bytes, returning how many were read
+    void pop(char* data, size_t nelements);                 // consumer only - read nelements bytes, waiting for them
+    size_t write(const char* data, size_t nelements);       // producer only - write up to nelements bytes, returning how many were written
+    void push(const char* data, size_t nelements);          // producer only - write nelements bytes, waiting for room
+
+    static const int POLL_INTERVAL = 100;                   // milliseconds between checks that the other side is alive
+
+private:
+    SharedCircular(const SharedCircular&) = delete;
+    SharedCircular& operator=(const SharedCircular&) = delete;
+
+    static const uint32_t MAGIC = 0x53434952;               // "SCIR", set once the header is ready
+    static const uint32_t VERSION = 1;                      // changes whenever the layout of the header does
+
+    // The start of the shared memory
+    struct Header {
+        alignas(CACHE_LINE) std::atomic<size_t> head;       // written by the consumer
+        alignas(CACHE_LINE) std::atomic<size_t> tail;       // written by the producer
+        alignas(CACHE_LINE) std::atomic<uint32_t> not_empty; // futex the consumer sleeps on, bumped to wake it
+        std::atomic<uint32_t> not_full;                     // futex the producer sleeps on, bumped to wake it
+        std::atomic<int> consumer_waiting;
+        std::atomic<int> producer_waiting;
+        std::atomic<int> consumer_pid;                      // 0 until the consumer first reads
+        std::atomic<int> producer_pid;                      // 0 until the producer first writes
+        uint32_t version;
+        size_t capacity;
+        std::atomic<uint32_t> magic;                        // released last by the creator
+    };
+
+    static size_t data_offset();                            // where the data starts in the shared memory
+    void map(int fd);                                       // map the shared memory, closing fd
+    void claim(std::atomic<int>& pid);                      // record this process as one side
+    void sleep(std::atomic<uint32_t>& futex, uint32_t seen, const std::atomic<int>& peer);  // wait for a wake or the peer to exit
+    void wake(std::atomic<int>& waiting, std::atomic<uint32_t>& futex);    // wake the other side if it is waiting
+
+    std::string name;
+    pid_t creator;                                          // 0 if attached
+    size_t length;                                          // the size of the shared memory
+    Header* header;
+    char* buffer;
+    bool consuming;                                         // has this process claimed the consumer side?
+    bool producing;                                         // has this process claimed the producer side?
+};
+
+// Constructor - create a named buffer to hold at least n bytes, rounded up to a power of 2
+//
+// The name must start with a / and not already exist
+inline SharedCircular::SharedCircular(const char* name, size_t n)
+    : name(name), creator(getpid()), length(0), header(nullptr), buffer(nullptr), consuming(false), producing(false) {
+    size_t capacity = round_up_power_of_2(n ? n : 1);
+    length = data_offset() + capacity;
+
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if(fd < 0) {
+        throw std::runtime_error(std::string("shm_open: ") + std::strerror(errno));
+    }
+    if(ftruncate(fd, length) != 0) {
+        int error = errno;
+        close(fd);
+        shm_unlink(name);
+        throw std::runtime_error(std::string("ftruncate: ") + std::strerror(error));
+    }
+    try {
+        map(fd);
+    }
+    catch(...) {
+        shm_unlink(name);
+        throw;
+    }
+
+    // The new shared memory is all zeros, so until the magic number is
+    // released an attaching process sees that the header is not ready
+    header = new(header) Header();
+    header->version = VERSION;
+    header->capacity = capacity;
+    header->magic.store(MAGIC, std::memory_order_release);
+}
+
+// Constructor - attach to a buffer another process created with the same name
+//
+// Throws if there is no such buffer, if it is not ready yet, or if it was made
+// by an incompatible version of this class
+inline SharedCircular::SharedCircular(const char* name)
+    : name(name), creator(0), length(0), header(nullptr), buffer(nullptr), consuming(false), producing(false) {
+    int fd = shm_open(name, O_RDWR, 0);
+    if(fd < 0) {
+        throw std::runtime_error(std::string("shm_open: ") + std::strerror(errno));
+    }
+    struct stat status;
+    if(fstat(fd, &status) != 0) {
+        int error = errno;
+        close(fd);
+        throw std::runtime_error(std::string("fstat: ") + std::strerror(error));
+    }
+    length = status.st_size;
+    if(length < data_offset()) {
+        close(fd);
+        throw std::runtime_error("Not a shared circular buffer: too small");
+    }
+    map(fd);
+
+    const char* problem = nullptr;
+    if(header->magic.load(std::memory_order_acquire) != MAGIC) {
+        problem = "Not a shared circular buffer, or not ready yet";
+    }
+    else if(header->version != VERSION) {
+        problem = "Shared circular buffer has a different version";
+    }
+    else if((header->capacity != round_up_power_of_2(header->capacity)) || (data_offset() + header->capacity != length)) {
+        problem = "Shared circular buffer has the wrong capacity";
+    }
+    if(problem != nullptr) {
+        munmap(header, length);
+        throw std::runtime_error(problem);
+    }
+}
+
+// Destructor - unmap the buffer, and remove it in the creating process
+inline SharedCircular::~SharedCircular() {
+    munmap(header, length);
+    if(getpid() == creator) {
+        shm_unlink(name.c_str());
+    }
+}
+
+// Map length bytes of the shared memory, closing fd
+inline void SharedCircular::map(int fd) {
+    void* mapped = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    int error = errno;
+    close(fd);  // the mapping keeps the shared memory alive
+    if(mapped == MAP_FAILED) {
+        throw std::runtime_error(std::string("mmap: ") + std::strerror(error));
+    }
+    header = static_cast<Header*>(mapped);
+    buffer = static_cast<char*>(mapped) + data_offset();
+}
+
+// Where the data starts in the shared memory, on a cache line of its own
+inline size_t SharedCircular::data_offset() {
+    return (sizeof(Header) + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE;
+}
+
+// The number of unused bytes available in the buffer
+inline size_t SharedCircular::available() const {
+    return capacity() - size();
+}
+
+// The number of bytes the buffer can hold
+inline size_t SharedCircular::capacity() const {
+    return header->capacity;
+}
+
+// Is the buffer empty?
+inline bool SharedCircular::empty() const {
+    return size() == 0;
+}
+
+// Has a consumer read from the buffer yet?
+inline bool SharedCircular::has_consumer() const {
+    return header->consumer_pid.load(std::memory_order_relaxed) != 0;
+}
+
+// Has a producer written to the buffer yet?
+inline bool SharedCircular::has_producer() const {
+    return header->producer_pid.load(std::memory_order_relaxed) != 0;
+}
+
+// The number of used bytes currently in the buffer
+inline size_t SharedCircular::size() const {
+    return header->tail.load(std::memory_order_acquire) - header->head.load(std::memory_order_acquire);
+}
+
+// Read up to nelements bytes, returning how many were read
+inline size_t SharedCircular::read(char* data, size_t nelements) {
+    if(!consuming) {
+        claim(header->consumer_pid);
+        consuming = true;
+    }
+
+    size_t head = header->head.load(std::memory_order_relaxed);
+    size_t tail = header->tail.load(std::memory_order_acquire);
+    size_t count = std::min(nelements, tail - head);
+    size_t mask = capacity() - 1;
+
+    // Copy in at most two pieces, either side of the wrap point
+    size_t first = std::min(count, capacity() - (head & mask));
+    std::memcpy(data, buffer + (head & mask), first);
+    std::memcpy(data + first, buffer, count - first);
+
+    if(count > 0) {
+        header->head.store(head + count, std::memory_order_release);
+        wake(header->producer_waiting, header->not_full);
+    }
+    return count;
+}
+
+// Read nelements bytes, waiting for them
+//
+// Throws if the buffer stays empty and the producer has exited
+inline void SharedCircular::pop(char* data, size_t nelements) {
+    for(size_t done = read(data, nelements); done < nelements; done += read(data + done, nelements - done)) {
+        header->consumer_waiting.store(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        uint32_t seen = header->not_empty.load(std::memory_order_relaxed);
+        if(empty()) {
+            sleep(header->not_empty, seen, header->producer_pid);
+        }
+        header->consumer_waiting.store(0, std::memory_order_relaxed);
+    }
+}
+
+// Write up to nelements bytes, returning how many were written
+inline size_t SharedCircular::write(const char* data, size_t nelements) {
+    if(!producing) {
+        claim(header->producer_pid);
+        producing = true;
+    }
+
+    size_t tail = header->tail.load(std::memory_order_relaxed);
+    size_t head = header->head.load(std::memory_order_acquire);
+    size_t count = std::min(nelements, capacity() - (tail - head));
+    size_t mask = capacity() - 1;
+
+    // Copy in at most two pieces, either side of the wrap point
+    size_t first = std::min(count, capacity() - (tail & mask));
+    std::memcpy(buffer + (tail & mask), data, first);
+    std::memcpy(buffer, data + first, count - first);
+
+    if(count > 0) {
+        header->tail.store(tail + count, std::memory_order_release);
+        wake(header->consumer_waiting, header->not_empty);
+    }
+    return count;
+}
+
+// Write nelements bytes, waiting for room
+//
+// Throws if the buffer stays full and the consumer has exited
+inline void SharedCircular::push(const char* data, size_t nelements) {
+    for(size_t done = write(data, nelements); done < nelements; done += write(data + done, nelements - done)) {
+        header->producer_waiting.store(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        uint32_t seen = header->not_full.load(std::memory_order_relaxed);
+        if(available() == 0) {
+            sleep(header->not_full, seen, header->consumer_pid);
+        }
+        header->producer_waiting.store(0, std::memory_order_relaxed);
+    }
+}
+
+// Record this process as one side, so that the other side can check it is alive
+inline void SharedCircular::claim(std::atomic<int>& pid) {
+    pid.store(getpid(), std::memory_order_relaxed);
+}
+
+// Wait until the futex no longer holds seen, checking every POLL_INTERVAL that
+// the peer process still exists
+//
+// The futex is not private to this process, since the other side is usually in
+// another process. If the word has already moved on from seen, the wake came
+// before the wait and the kernel returns straight away. A peer that has not
+// read or written yet has no process id to check, so it is waited for. A peer
+// that has exited but not been reaped by its parent still looks alive
+inline void SharedCircular::sleep(std::atomic<uint32_t>& futex, uint32_t seen, const std::atomic<int>& peer) {
+    timespec timeout = {POLL_INTERVAL / 1000, (POLL_INTERVAL % 1000) * 1000000L};
+    if(syscall(SYS_futex, reinterpret_cast<uint32_t*>(&futex), FUTEX_WAIT, seen, &timeout, nullptr, 0) == 0) {
+        return;
+    }
+    if(errno == ETIMEDOUT) {
+        int pid = peer.load(std::memory_order_relaxed);
+        if((pid != 0) && (kill(pid, 0) != 0) && (errno == ESRCH)) {
+            throw std::runtime_error("The other side of the shared circular buffer has exited");
+        }
+    }
+    else if((errno != EAGAIN) && (errno != EINTR)) {
+        throw std::runtime_error(std::string("futex: ") + std::strerror(errno));
+    }
+}
+
+// Wake the other side if it is waiting
+//
+// The fence orders the counter just stored before the load of the flag, and
+// pairs with the fence in pop() or push(): either the other side sees the new
+// counter and does not sleep, or this side sees its flag and wakes it. The
+// futex is bumped before the wake, so a side that read it before sleeping
+// either returns from FUTEX_WAIT at once or is woken
+inline void SharedCircular::wake(std::atomic<int>& waiting, std::atomic<uint32_t>& futex) {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if(waiting.load(std::memory_order_relaxed) && waiting.exchange(0, std::memory_order_relaxed)) {
+        futex.fetch_add(1, std::memory_order_relaxed);
+        if(syscall(SYS_futex, reinterpret_cast<uint32_t*>(&futex), FUTEX_WAKE, 1, nullptr, nullptr, 0) < 0) {
+            throw std::runtime_error(std::string("futex: ") + std::strerror(errno));
+        }
+    }
+}
+
+#endif
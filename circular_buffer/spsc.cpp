@@ -0,0 +1,144 @@
+// Hand bytes from one thread to another through a lock-free single-producer/
+// single-consumer circular buffer
+
+#include <chrono>       // For steady_clock
+#include <cstring>      // For strlen
+#include <iostream>     // For cout etc
+#include <thread>       // For thread, yield
+#include <vector>       // For vector
+
+#include "spsc.hpp"
+
+using namespace std;
+
+// Total number of bytes to hand over, and the size of each write and read
+const size_t TOTAL = 256 << 20;
+const size_t CHUNK = 4096;
+
+// The byte expected at each position of the stream
+inline char pattern(size_t i) {
+    return static_cast<char>(i * 131 + (i >> 12));
+}
+
+// Hand TOTAL bytes of a known pattern from a producer thread to a consumer
+// thread that checks them, either copying through write() and read() or working
+// in place through reserve()/commit() and peek()/release()
+void hand_over(bool zero_copy) {
+    SpscCircular stream(1 << 16);
+    bool correct = true;
+    auto start = chrono::steady_clock::now();
+
+    thread producer([&]() {
+        vector<char> chunk(CHUNK);
+        for(size_t i = 0; i < TOTAL; ) {
+            if(zero_copy) {
+                Span space = stream.reserve();
+                size_t n = min(space.size, TOTAL - i);
+                if(n == 0) {
+                    this_thread::yield();
+                }
+                for(size_t j = 0; j < n; j++) {
+                    space.data[j] = pattern(i + j);
+                }
+                stream.commit(n);
+                i += n;
+                continue;
+            }
+
+            size_t n = min(CHUNK, TOTAL - i);
+            for(size_t j = 0; j < n; j++) {
+                chunk[j] = pattern(i + j);
+            }
+            for(size_t done = 0; done < n; ) {
+                size_t count = stream.write(chunk.data() + done, n - done);
+                if(count == 0) {
+                    this_thread::yield();
+                }
+                done += count;
+            }
+            i += n;
+        }
+    });
+
+    thread consumer([&]() {
+        vector<char> chunk(CHUNK);
+        for(size_t i = 0; i < TOTAL; ) {
+            Span data = { chunk.data(), 0 };
+            if(zero_copy) {
+                data = stream.peek();
+            }
+            else {
+                data.size = stream.read(chunk.data(), CHUNK);
+            }
+            if(data.size == 0) {
+                this_thread::yield();
+            }
+            for(size_t j = 0; j < data.size; j++) {
+                correct = correct && (data.data[j] == pattern(i + j));
+            }
+            if(zero_copy) {
+                stream.release(data.size);
+            }
+            i += data.size;
+        }
+    });
+
+    producer.join();
+    consumer.join();
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+
+    cout << "Handed " << (TOTAL >> 20) << "MB between threads " << (zero_copy ? "in place" : "by copying") << ": "
+         << (correct ? "correct" : "incorrect") << ", "
+         << static_cast<size_t>(TOTAL / elapsed.count() / 1e6) << "MB/s" << endl;
+}
+
+int main() {
+    // Single-threaded use
+    SpscCircular spsc(20);
+    cout << "Capacity of a buffer created for 20 bytes: " << spsc.capacity() << endl;
+
+    const char* data = "abcdefghijklmnopqrstuvwxyz0123456789";
+    size_t written = spsc.write(data, strlen(data));
+    cout << "Wrote " << written << " of " << strlen(data) << " bytes, size is " << spsc.size() << endl;
+
+    char buffer[40] {};
+    size_t read = spsc.read(buffer, 10);
+    cout << "Read " << read << " bytes: " << string(buffer, read) << endl;
+
+    written = spsc.write("ABCDEFGHIJ", 10);
+    cout << "Wrote " << written << " bytes and wrapped around, size is " << spsc.size() << endl;
+
+    read = spsc.read(buffer, sizeof(buffer));
+    cout << "Read " << read << " bytes: " << string(buffer, read) << endl;
+
+    char c {};
+    cout << "Read from an empty buffer: " << boolalpha << spsc.read(c) << endl;
+
+    // Zero-copy use, filling and parsing the buffer in place
+    string records = "alpha;bravo;charlie;delta;echo;";
+    for(size_t done = 0; done < records.size(); ) {
+        Span space = spsc.reserve();
+        size_t n = min(space.size, records.size() - done);
+        copy(records.begin() + done, records.begin() + done + n, space.data);
+        spsc.commit(n);
+        cout << "Reserved " << space.size << " contiguous bytes, filled and committed " << n << endl;
+        done += n;
+    }
+
+    for(Span data = spsc.peek(); data.size > 0; data = spsc.peek()) {
+        cout << "Peeked " << data.size << " contiguous bytes: " << string(data.data, data.size) << endl;
+        spsc.release(data.size);
+    }
+
+    try {
+        spsc.release(1);
+    }
+    catch(exception& e) {
+        cout << e.what() << endl;
+    }
+    cout << endl;
+
+    // Cross-thread use
+    hand_over(false);
+    hand_over(true);
+}
@@ -0,0 +1,233 @@
+// A lock-free single-producer/single-consumer circular buffer of bytes
+
+#ifndef SPSC_H
+#define SPSC_H
+
+#include <algorithm>    // For copy, min
+#include <atomic>       // For atomic
+#include <cstddef>      // For size_t
+#include <stdexcept>    // For runtime_error
+
+// Size of a cache line, used to keep the producer's and consumer's data apart
+const size_t CACHE_LINE = 64;
+
+// Round up to the next power of 2
+inline size_t round_up_power_of_2(size_t n) {
+    size_t power = 1;
+    while(power < n) {
+        power <<= 1;
+    }
+    return power;
+}
+
+// A contiguous region of a buffer
+struct Span {
+    char* data;
+    size_t size;
+};
+
+// One thread (the producer) may write to the buffer while another thread (the
+// consumer) reads from it, without any locks
+//
+// head and tail are free-running counters of the bytes read and written, so
+// the buffer can be completely full and positions are found with a mask rather
+// than %. Each counter is written by only one side, released after the data it
+// covers has been copied and acquired by the other side before that data is
+// touched. Each side also keeps a cached copy of the other side's counter and
+// only reloads it when the cached copy says there is not enough room or data,
+// so in the steady state the shared cache lines are rarely transferred
+//
+// Each side's counters are aligned to a cache line of their own. Before C++17
+// new does not honour that alignment, so a buffer made with new may share its
+// first cache line with other data, though the two sides still never share one
+class alignas(CACHE_LINE) SpscCircular {
+public:
+    SpscCircular(size_t n);                                 // constructor - create a buffer to hold at least n bytes
+    ~SpscCircular();                                        // destructor - destroy the buffer
+
+    size_t available() const;                               // the number of unused bytes available in the buffer
+    size_t capacity() const;                                // the number of bytes the buffer can hold
+    bool empty() const;                                     // is the buffer empty?
+    size_t size() const;                                    // the number of used bytes currently in the buffer
+
+    // Consumer only
+    bool read(char& c);                                     // read one byte if there is one
+    size_t read(char* data, size_t nelements);              // read up to nelements bytes, returning how many were read
+    Span peek();                                            // the used bytes at the head that are contiguous, to work on in place
+    void release(size_t nelements);                         // remove bytes from the head after using peek()
+
+    // Producer only
+    bool write(char c);                                     // write one byte if there is room
+    size_t write(const char* data, size_t nelements);       // write up to nelements bytes, returning how many were written
+    Span reserve();                                         // the unused bytes at the tail that are contiguous, to fill in place
+    void commit(size_t nelements);                          // add bytes at the tail after filling reserve()
+
+private:
+    SpscCircular(const SpscCircular&) = delete;
+    SpscCircular& operator=(const SpscCircular&) = delete;
+
+    // Consumer's cache line
+    alignas(CACHE_LINE) std::atomic<size_t> head;           // total bytes read, written by the consumer
+    size_t cached_tail;                                     // the consumer's copy of tail
+
+    // Producer's cache line
+    alignas(CACHE_LINE) std::atomic<size_t> tail;           // total bytes written, written by the producer
+    size_t cached_head;                                     // the producer's copy of head
+
+    // Read-only after construction
+    alignas(CACHE_LINE) const size_t mask;
+    char* const buffer;
+};
+
+// Constructor - create a buffer to hold at least n bytes, rounded up to a power of 2
+inline SpscCircular::SpscCircular(size_t n)
+    : head(0), cached_tail(0), tail(0), cached_head(0),
+      mask(round_up_power_of_2(n ? n : 1) - 1), buffer(new char[mask + 1]) {
+}
+
+// Destructor - destroy the buffer
+inline SpscCircular::~SpscCircular() {
+    delete[] buffer;
+}
+
+// The number of unused bytes available in the buffer
+inline size_t SpscCircular::available() const {
+    return capacity() - size();
+}
+
+// The number of bytes the buffer can hold
+inline size_t SpscCircular::capacity() const {
+    return mask + 1;
+}
+
+// Is the buffer empty?
+inline bool SpscCircular::empty() const {
+    return size() == 0;
+}
+
+// The number of used bytes currently in the buffer
+//
+// This is only a snapshot if the other side is active at the same time
+inline size_t SpscCircular::size() const {
+    size_t h = head.load(std::memory_order_acquire);
+    size_t t = tail.load(std::memory_order_acquire);
+    return t - h;
+}
+
+// Read one byte if there is one
+inline bool SpscCircular::read(char& c) {
+    size_t h = head.load(std::memory_order_relaxed);
+    if(h == cached_tail) {
+        cached_tail = tail.load(std::memory_order_acquire);
+        if(h == cached_tail) {
+            return false;
+        }
+    }
+
+    c = buffer[h & mask];
+    head.store(h + 1, std::memory_order_release);
+    return true;
+}
+
+// Read up to nelements bytes, returning how many were read
+inline size_t SpscCircular::read(char* data, size_t nelements) {
+    size_t h = head.load(std::memory_order_relaxed);
+    if(cached_tail - h < nelements) {
+        cached_tail = tail.load(std::memory_order_acquire);
+    }
+    size_t n = std::min(nelements, cached_tail - h);
+    if(n == 0) {
+        return 0;
+    }
+
+    // The data may wrap around the end of the buffer i.e. [..T..H..]
+    size_t start = h & mask;
+    size_t right = std::min(n, capacity() - start);
+    std::copy(buffer + start, buffer + start + right, data);
+    std::copy(buffer, buffer + (n - right), data + right);
+
+    head.store(h + n, std::memory_order_release);
+    return n;
+}
+
+// Write one byte if there is room
+inline bool SpscCircular::write(char c) {
+    size_t t = tail.load(std::memory_order_relaxed);
+    if(t - cached_head == capacity()) {
+        cached_head = head.load(std::memory_order_acquire);
+        if(t - cached_head == capacity()) {
+            return false;
+        }
+    }
+
+    buffer[t & mask] = c;
+    tail.store(t + 1, std::memory_order_release);
+    return true;
+}
+
+// Write up to nelements bytes, returning how many were written
+inline size_t SpscCircular::write(const char* data, size_t nelements) {
+    size_t t = tail.load(std::memory_order_relaxed);
+    if(capacity() - (t - cached_head) < nelements) {
+        cached_head = head.load(std::memory_order_acquire);
+    }
+    size_t n = std::min(nelements, capacity() - (t - cached_head));
+    if(n == 0) {
+        return 0;
+    }
+
+    // The space may wrap around the end of the buffer i.e. [..H..T..]
+    size_t start = t & mask;
+    size_t right = std::min(n, capacity() - start);
+    std::copy(data, data + right, buffer + start);
+    std::copy(data + right, data + n, buffer);
+
+    tail.store(t + n, std::memory_order_release);
+    return n;
+}
+
+// The used bytes at the head that are contiguous, to work on in place
+//
+// If the data wraps around the end of the buffer this is only the part up to
+// the end, and the rest follows once that has been released
+inline Span SpscCircular::peek() {
+    size_t h = head.load(std::memory_order_relaxed);
+    cached_tail = tail.load(std::memory_order_acquire);
+    size_t start = h & mask;
+    Span span = { buffer + start, std::min(cached_tail - h, capacity() - start) };
+    return span;
+}
+
+// Remove bytes from the head after using peek(), handing the space back to
+// the producer
+inline void SpscCircular::release(size_t nelements) {
+    size_t h = head.load(std::memory_order_relaxed);
+    if(cached_tail - h < nelements) {
+        throw std::runtime_error("Invalid operation: not enough data to release");
+    }
+    head.store(h + nelements, std::memory_order_release);
+}
+
+// The unused bytes at the tail that are contiguous, to fill in place e.g. by
+// reading from a socket straight into the buffer
+//
+// If the space wraps around the end of the buffer this is only the part up to
+// the end, and the rest follows once that has been committed
+inline Span SpscCircular::reserve() {
+    size_t t = tail.load(std::memory_order_relaxed);
+    cached_head = head.load(std::memory_order_acquire);
+    size_t start = t & mask;
+    Span span = { buffer + start, std::min(capacity() - (t - cached_head), capacity() - start) };
+    return span;
+}
+
+// Add bytes at the tail after filling reserve(), publishing them to the consumer
+inline void SpscCircular::commit(size_t nelements) {
+    size_t t = tail.load(std::memory_order_relaxed);
+    if(capacity() - (t - cached_head) < nelements) {
+        throw std::runtime_error("Invalid operation: not enough space to commit");
+    }
+    tail.store(t + nelements, std::memory_order_release);
+}
+
+#endif
@@ -0,0 +1,82 @@
+// A lossy circular buffer for telemetry, where the producer never blocks or
+// fails but overwrites the oldest records when the buffer is full
+
+#include <iostream>     // For cout etc
+#include <thread>       // For thread
+#include <vector>       // For vector
+
+#include "telemetry.hpp"
+
+using namespace std;
+
+// A trace record, with a check value so that torn copies would be noticed
+struct Record {
+    size_t sequence;
+    double timestamp;
+    unsigned int event;
+    size_t check;
+
+    static Record make(size_t sequence) {
+        Record record = { sequence, sequence * 0.5, static_cast<unsigned int>(sequence % 7), ~sequence };
+        return record;
+    }
+
+    bool valid() const {
+        return (check == ~sequence) && (timestamp == sequence * 0.5) && (event == sequence % 7);
+    }
+};
+
+int main() {
+    // Create a telemetry buffer
+    TelemetryCircular<Record> telemetry(5);
+    cout << "Capacity of a buffer created for 5 records: " << telemetry.capacity() << endl;
+
+    // Write more records than fit, the oldest are overwritten rather than throwing
+    for(size_t i = 0; i < 20; i++) {
+        telemetry.write(Record::make(i));
+    }
+    vector<Record> records;
+    telemetry.drain(records);
+    cout << "Wrote 20 records, drained " << records.size() << ":";
+    for(const Record& record : records) {
+        cout << " " << record.sequence;
+    }
+    cout << ", dropped " << telemetry.dropped() << endl;
+
+    // Draining again finds nothing new
+    cout << "Drained again: " << telemetry.drain(records) << " records" << endl;
+
+    // A producer writes as fast as it can while a consumer drains snapshots
+    const size_t total = 10000000;
+    TelemetryCircular<Record> traced(1024);
+    thread producer([&]() {
+        for(size_t i = 0; i < total; i++) {
+            traced.write(Record::make(i));
+        }
+    });
+
+    size_t drains = 0;
+    size_t drained = 0;
+    size_t next = 0;
+    bool consistent = true;
+    for(bool done = false; !done; ) {
+        done = (traced.written() == total);  // drain once more after the producer finishes
+        traced.drain(records);
+        drains++;
+        drained += records.size();
+        for(size_t i = 0; i < records.size(); i++) {
+            // Each snapshot is contiguous and newer than the last one
+            bool in_order = (i == 0) ? (records[i].sequence >= next) : (records[i].sequence == records[i - 1].sequence + 1);
+            consistent = consistent && in_order && records[i].valid();
+        }
+        if(!records.empty()) {
+            next = records.back().sequence + 1;
+        }
+    }
+    producer.join();
+
+    cout << "Producer wrote " << total << " records, consumer drained " << drained
+         << " in " << drains << " batches and " << traced.dropped() << " were dropped" << endl;
+    cout << "Snapshots were " << (consistent ? "consistent" : "inconsistent")
+         << ", drained plus dropped is " << (drained + traced.dropped() == total ? "correct" : "incorrect") << endl;
+}
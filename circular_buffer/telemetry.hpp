@@ -0,0 +1,160 @@
+// A lossy circular buffer for telemetry, where the producer never blocks or
+// fails but overwrites the oldest records when the buffer is full
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <atomic>       // For atomic, atomic_thread_fence
+#include <cstddef>      // For size_t
+#include <cstring>      // For memcpy
+#include <type_traits>  // For is_trivially_copyable
+#include <vector>       // For vector
+
+#include "spsc.hpp"     // For CACHE_LINE, round_up_power_of_2
+
+// Unlike Circular, which throws runtime_error when it is full, write() always
+// succeeds: once the buffer is full each write replaces the oldest record. The
+// consumer drains everything still in the buffer in one batch and counts the
+// records that were overwritten before it got to them as dropped
+//
+// There may be one producer thread and one consumer thread at the same time.
+// Each slot is protected by a sequence number as in a seqlock: it is odd while
+// the producer is writing the slot and even when it is done, so the consumer
+// can copy a record without locking and then check that it was not being
+// overwritten at the same time. Records are copied as words of relaxed atomics
+// to keep the racing copies well-defined, so T must be trivially copyable
+template<typename T>
+class TelemetryCircular {
+    static_assert(std::is_trivially_copyable<T>::value, "records must be trivially copyable");
+
+public:
+    TelemetryCircular(size_t n);                            // constructor - create a buffer to hold at least n records
+    ~TelemetryCircular();                                   // destructor - destroy the buffer
+
+    size_t capacity() const;                                // the number of records the buffer can hold
+    size_t dropped() const;                                 // consumer only - the number of records overwritten before being drained
+    size_t written() const;                                 // the number of records written so far
+
+    void write(const T& record);                            // producer only - write a record, overwriting the oldest if full
+    size_t drain(std::vector<T>& records);                  // consumer only - read all the records in the buffer, oldest first
+
+private:
+    TelemetryCircular(const TelemetryCircular&) = delete;
+    TelemetryCircular& operator=(const TelemetryCircular&) = delete;
+
+    typedef unsigned long Word;
+    static const size_t WORDS = (sizeof(T) + sizeof(Word) - 1) / sizeof(Word);
+
+    struct Slot {
+        std::atomic<size_t> sequence;                       // 2 * position + 1 while being written, 2 * position + 2 when written
+        std::atomic<Word> words[WORDS];
+    };
+
+    bool copy(size_t position, T& record) const;            // copy the record at a free-running position if it is still there
+
+    alignas(CACHE_LINE) std::atomic<size_t> head;           // written by the producer
+    alignas(CACHE_LINE) size_t tail;                        // consumer only
+    size_t lost;                                            // consumer only
+    const size_t mask;
+    Slot* const slots;
+};
+
+// Constructor - create a buffer to hold at least n records, rounded up to a power of 2
+template<typename T>
+TelemetryCircular<T>::TelemetryCircular(size_t n)
+    : head(0), tail(0), lost(0), mask(round_up_power_of_2(n ? n : 1) - 1), slots(new Slot[mask + 1]) {
+    for(size_t i = 0; i <= mask; i++) {
+        slots[i].sequence.store(0, std::memory_order_relaxed);
+    }
+}
+
+// Destructor - destroy the buffer
+template<typename T>
+TelemetryCircular<T>::~TelemetryCircular() {
+    delete[] slots;
+}
+
+// The number of records the buffer can hold
+template<typename T>
+size_t TelemetryCircular<T>::capacity() const {
+    return mask + 1;
+}
+
+// The number of records overwritten before being drained
+template<typename T>
+size_t TelemetryCircular<T>::dropped() const {
+    return lost;
+}
+
+// The number of records written so far
+template<typename T>
+size_t TelemetryCircular<T>::written() const {
+    return head.load(std::memory_order_acquire);
+}
+
+// Write a record, overwriting the oldest if the buffer is full
+template<typename T>
+void TelemetryCircular<T>::write(const T& record) {
+    size_t position = head.load(std::memory_order_relaxed);
+    Slot& slot = slots[position & mask];
+
+    Word words[WORDS] = {};
+    std::memcpy(words, &record, sizeof(T));
+
+    slot.sequence.store(2 * position + 1, std::memory_order_relaxed);  // mark the slot as being written
+    std::atomic_thread_fence(std::memory_order_release);                // before any of the record is
+    for(size_t i = 0; i < WORDS; i++) {
+        slot.words[i].store(words[i], std::memory_order_relaxed);
+    }
+    slot.sequence.store(2 * position + 2, std::memory_order_release);  // publish the record
+    head.store(position + 1, std::memory_order_release);
+}
+
+// Copy the record at a free-running position, returning false if it has been
+// or is being overwritten
+template<typename T>
+bool TelemetryCircular<T>::copy(size_t position, T& record) const {
+    const Slot& slot = slots[position & mask];
+
+    size_t before = slot.sequence.load(std::memory_order_acquire);
+    Word words[WORDS];
+    for(size_t i = 0; i < WORDS; i++) {
+        words[i] = slot.words[i].load(std::memory_order_relaxed);
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);                // all of the record is read
+    size_t after = slot.sequence.load(std::memory_order_relaxed);       // before checking it again
+
+    if((before != after) || (before != 2 * position + 2)) {
+        return false;
+    }
+    std::memcpy(&record, words, sizeof(T));
+    return true;
+}
+
+// Read all the records in the buffer, oldest first, replacing the contents of
+// records and returning how many there are
+//
+// The records form a consistent snapshot: a contiguous run of positions with
+// no gaps, ending with the newest record written when the drain started. The
+// producer overwrites in order, so if it laps the consumer during the drain
+// the records it overwrote are at the start of the run and are dropped
+template<typename T>
+size_t TelemetryCircular<T>::drain(std::vector<T>& records) {
+    size_t end = head.load(std::memory_order_acquire);
+    size_t start = (end - tail > capacity()) ? end - capacity() : tail;
+
+    records.resize(end - start);
+    size_t first = start;   // the oldest position that survived the copy
+    for(size_t position = start; position < end; position++) {
+        if(!copy(position, records[position - start])) {
+            first = position + 1;
+        }
+    }
+    records.erase(records.begin(), records.begin() + (first - start));
+
+    lost += first - tail;
+    tail = end;
+    return records.size();
+}
+
+#endif
@@ -0,0 +1,84 @@
+// A circular buffer (or ring buffer) of any type using an array
+
+#include <iostream>     // For cout etc
+#include <memory>       // For unique_ptr
+#include <string>       // For string
+
+#include "template.hpp"
+
+using namespace std;
+
+// A move-only message, counting how many are alive
+struct Message {
+    static int alive;
+
+    int id;
+    unique_ptr<string> payload;
+
+    Message(int id, const string& text) : id(id), payload(new string(text)) { alive++; }
+    Message(Message&& rhs) : id(rhs.id), payload(move(rhs.payload)) { alive++; }
+    Message& operator=(Message&& rhs) { id = rhs.id; payload = move(rhs.payload); return *this; }
+    ~Message() { alive--; }
+};
+
+int Message::alive = 0;
+
+int main() {
+    {
+        // Create a circular buffer of move-only messages
+        Circular<Message> circular(5);
+        cout << "Capacity of a buffer created for 5 messages: " << circular.capacity() << endl;
+
+        // Read when the buffer is empty
+        try {
+            circular.read();
+        }
+        catch(exception& e) {
+            cout << e.what() << endl;
+        }
+
+        // Construct messages in place at the tail
+        for(int i = 0; i < 6; i++) {
+            circular.emplace(i, "message " + to_string(i));
+        }
+        cout << "Emplaced 6 messages, size is " << circular.size() << ", alive is " << Message::alive << endl;
+
+        // Read one at a time from the head, destroying them in the buffer
+        for(int i = 0; i < 4; i++) {
+            Message message = circular.read();
+            cout << "Read " << message.id << ": " << *message.payload << endl;
+        }
+        cout << "Size is " << circular.size() << ", alive is " << Message::alive << endl;
+
+        // Write moved messages to the tail and wrap-around
+        for(int i = 6; i < 12; i++) {
+            circular.write(Message(i, "message " + to_string(i)));
+        }
+        cout << "Wrote 6 more messages, size is " << circular.size() << endl;
+
+        // Write when the buffer is full
+        try {
+            circular.emplace(99, "one too many");
+        }
+        catch(exception& e) {
+            cout << e.what() << endl;
+        }
+
+        // Read many at a time from the head and wrap-around
+        Message messages[5] {
+            { 0, "" }, { 0, "" }, { 0, "" }, { 0, "" }, { 0, "" }
+        };
+        circular.read(messages, 5);
+        for(const Message& message : messages) {
+            cout << "Read " << message.id << ": " << *message.payload << endl;
+        }
+        cout << "Size is " << circular.size() << ", leaving the rest for the destructor" << endl;
+
+        // Copyable elements can also be written many at a time
+        Circular<int> numbers(4);
+        int data[] = { 1, 2, 3, 4 };
+        numbers.write(data, 4);
+        cout << "Wrote 4 ints to a buffer of " << numbers.capacity() << ", available is " << numbers.available() << endl;
+    }
+    cout << "All buffers destroyed, alive is " << Message::alive << endl;
+}
@@ -0,0 +1,180 @@
+// A circular buffer (or ring buffer) of any type using an array
+
+#ifndef TEMPLATE_H
+#define TEMPLATE_H
+
+#include <cstddef>      // For size_t
+#include <new>          // For placement new
+#include <stdexcept>    // For runtime_error
+#include <type_traits>  // For aligned_storage
+#include <utility>      // For forward, move
+
+#include "spsc.hpp"     // For round_up_power_of_2
+
+// Elements are constructed in place when written and destroyed when read, so
+// T may be move-only and unused slots are never filled or cleared. The capacity
+// is a power of 2, and head and tail are free-running counters, so positions
+// are found with a mask rather than % and a full buffer is not mistaken for an
+// empty one
+//
+// Like Circular this is not thread-safe
+template<typename T>
+class Circular {
+public:
+    Circular(size_t n);                                     // constructor - create a circular buffer to hold at least n elements
+    ~Circular();                                            // destructor - destroy any elements and the circular buffer
+
+    size_t available() const;                               // the number of unused elements available in the buffer
+    size_t capacity() const;                                // the number of elements the buffer can hold
+    void clear();                                           // clear the buffer
+    bool empty() const;                                     // is the buffer empty?
+    size_t size() const;                                    // the number of used elements currently in the buffer
+
+    T read();                                               // read one at a time from the head of the circular buffer
+    void read(T* data, size_t nelements);                   // read many at a time from the head of the circular buffer
+    void write(const T& value);                             // write one at a time to the tail of the circular buffer
+    void write(T&& value);                                  // write one at a time to the tail of the circular buffer
+    void write(const T* data, size_t nelements);            // write many at a time to the tail of the circular buffer
+
+    template<typename... Args>
+    void emplace(Args&&... args);                           // construct one in place at the tail of the circular buffer
+
+private:
+    Circular(const Circular&) = delete;
+    Circular& operator=(const Circular&) = delete;
+
+    typedef typename std::aligned_storage<sizeof(T), alignof(T)>::type Slot;
+
+    T* slot(size_t position);                               // the element at a free-running position
+
+    size_t head;
+    size_t tail;
+    const size_t mask;
+    Slot* const buffer;
+};
+
+// Constructor - create a circular buffer to hold at least n elements, rounded up to a power of 2
+template<typename T>
+Circular<T>::Circular(size_t n)
+    : head(0), tail(0), mask(round_up_power_of_2(n ? n : 1) - 1), buffer(new Slot[mask + 1]) {
+}
+
+// Destructor - destroy any elements and the circular buffer
+template<typename T>
+Circular<T>::~Circular() {
+    clear();
+    delete[] buffer;
+}
+
+// The element at a free-running position
+template<typename T>
+T* Circular<T>::slot(size_t position) {
+    return reinterpret_cast<T*>(&buffer[position & mask]);
+}
+
+// The number of unused elements available in the buffer
+template<typename T>
+size_t Circular<T>::available() const {
+    return capacity() - size();
+}
+
+// The number of elements the buffer can hold
+template<typename T>
+size_t Circular<T>::capacity() const {
+    return mask + 1;
+}
+
+// Clear the buffer, destroying any elements
+template<typename T>
+void Circular<T>::clear() {
+    for( ; head != tail; head++) {
+        slot(head)->~T();
+    }
+    head = 0;
+    tail = 0;
+}
+
+// Is the buffer empty?
+template<typename T>
+bool Circular<T>::empty() const {
+    return head == tail;
+}
+
+// The number of used elements currently in the buffer
+template<typename T>
+size_t Circular<T>::size() const {
+    return tail - head;
+}
+
+// Read one at a time from the head of the circular buffer
+template<typename T>
+T Circular<T>::read() {
+    if(empty()) {
+        throw std::runtime_error("Invalid operation: the buffer is empty");
+    }
+
+    T* element = slot(head);
+    T value(std::move(*element));
+    element->~T();  // remove from the head
+    head++;         // move the head rightwards, the mask handles wrap-around
+    return value;
+}
+
+// Read many at a time from the head of the circular buffer
+template<typename T>
+void Circular<T>::read(T* data, size_t nelements) {
+    if((data == nullptr) || (nelements == 0)) {
+        throw std::runtime_error("Bad arguments");
+    }
+    if(size() < nelements) {
+        throw std::runtime_error("Invalid operation: not enough data to read");
+    }
+
+    for(size_t i = 0; i < nelements; i++) {
+        T* element = slot(head);
+        data[i] = std::move(*element);
+        element->~T();
+        head++;
+    }
+}
+
+// Write one at a time to the tail of the circular buffer
+template<typename T>
+void Circular<T>::write(const T& value) {
+    emplace(value);
+}
+
+template<typename T>
+void Circular<T>::write(T&& value) {
+    emplace(std::move(value));
+}
+
+// Write many at a time to the tail of the circular buffer
+template<typename T>
+void Circular<T>::write(const T* data, size_t nelements) {
+    if((data == nullptr) || (nelements == 0)) {
+        throw std::runtime_error("Bad arguments");
+    }
+    if(available() < nelements) {
+        throw std::runtime_error("Invalid operation: not enough space to write");
+    }
+
+    for(size_t i = 0; i < nelements; i++) {
+        new(slot(tail)) T(data[i]);
+        tail++;
+    }
+}
+
+// Construct one in place at the tail of the circular buffer
+template<typename T>
+template<typename... Args>
+void Circular<T>::emplace(Args&&... args) {
+    if(available() < 1) {
+        throw std::runtime_error("Invalid operation: the buffer is full");
+    }
+
+    new(slot(tail)) T(std::forward<Args>(args)...);  // append at the tail
+    tail++;                                         // move the tail rightwards, the mask handles wrap-around
+}
+
+#endif
@@ -0,0 +1,232 @@
+// Benchmark the matrix multiply kernels
+//
+// Usage: benchmark [--config <file>] [--retune] [--max-size <n>] [--peak <GFLOP/s>]
+//
+// Each kernel is run over a sweep of sizes and shapes and reported in GFLOP/s,
+// counting each multiply and each add as one operation even though these are
+// integer operations, along with the fraction of the theoretical peak. The
+// peak defaults to the clock rate in /proc/cpuinfo times OPS_PER_CYCLE.
+//
+// On startup the tile size for the tiled kernel is read from the configuration
+// file (matrix_multiply.conf by default). If that does not exist yet, or if
+// --retune is given, the tile size is tuned for this machine's caches and saved.
+
+#include <algorithm>    // For std::copy
+#include <chrono>       // For std::chrono::steady_clock
+#include <cstdlib>      // For std::atoi, std::atof
+#include <cstring>      // For std::strcmp
+#include <fstream>      // For std::ifstream
+#include <iomanip>      // For std::setw, std::setprecision
+#include <iostream>     // For std::cout etc
+#include <string>       // For std::string
+#include <vector>       // For std::vector
+
+#include "matrix_multiply.hpp"
+
+// Operations per cycle for one core, assuming AVX2 with eight 32-bit lanes and
+// one vector multiply plus one vector add per cycle
+const double OPS_PER_CYCLE = 16.0;
+
+// Keep results alive so that the compiler cannot optimise the work away
+volatile int sink = 0;
+
+// Time a function, repeating it until at least 0.2s have elapsed, and return
+// the average number of seconds per call
+template<typename F>
+double time_per_call(F f) {
+    unsigned int calls = 0;
+    std::chrono::duration<double> elapsed {};
+    auto start = std::chrono::steady_clock::now();
+    do {
+        f();
+        calls++;
+        elapsed = std::chrono::steady_clock::now() - start;
+    } while(elapsed.count() < 0.2);
+    return elapsed.count() / calls;
+}
+
+// Theoretical peak GFLOP/s for one core, from the clock rate in /proc/cpuinfo
+//
+// Returns 0 if the clock rate is not known
+double peak_gflops() {
+    std::ifstream cpuinfo("/proc/cpuinfo");
+    std::string line;
+    while(std::getline(cpuinfo, line)) {
+        if(line.compare(0, 7, "cpu MHz") == 0) {
+            std::string::size_type colon = line.find(':');
+            if(colon != std::string::npos) {
+                return std::atof(line.c_str() + colon + 1) / 1000.0 * OPS_PER_CYCLE;
+            }
+        }
+    }
+    return 0.0;
+}
+
+// Print one result
+void report(const std::string& shape, const std::string& kernel, double ops, double seconds, double peak) {
+    double gflops = ops / seconds / 1e9;
+    std::cout << std::setw(24) << std::left << shape
+              << std::setw(10) << kernel << std::right
+              << std::setw(10) << std::fixed << std::setprecision(2) << gflops;
+    if(peak > 0.0) {
+        std::cout << std::setw(9) << std::setprecision(1) << 100.0 * gflops / peak << "%";
+    }
+    else {
+        std::cout << std::setw(10) << "n/a";
+    }
+    std::cout << std::endl;
+}
+
+// Benchmark the general kernels on one m x n by n x p product
+void benchmark_shape(unsigned int m, unsigned int n, unsigned int p, unsigned int tile, double peak) {
+    std::vector<int> a(m * n);
+    std::vector<int> b(n * p);
+    std::vector<int> c(m * p);
+    for(unsigned int i = 0; i < a.size(); i++) {
+        a[i] = static_cast<int>(i % 7) - 3;
+    }
+    for(unsigned int i = 0; i < b.size(); i++) {
+        b[i] = static_cast<int>(i % 5) - 2;
+    }
+
+    std::string shape = std::to_string(m) + "x" + std::to_string(n) + " * " +
+                        std::to_string(n) + "x" + std::to_string(p);
+    double ops = 2.0 * m * n * p;
+
+    report(shape, "naive", ops, time_per_call([&]() {
+        int* multiplied = multiply(a.data(), m, n, b.data(), n, p);
+        sink += multiplied[0];
+        delete[] multiplied;
+    }), peak);
+
+    report(shape, "reordered", ops, time_per_call([&]() {
+        multiply_into(a.data(), m, n, b.data(), p, c.data());
+        sink += c[0];
+    }), peak);
+
+    report(shape, "tiled", ops, time_per_call([&]() {
+        multiply_tiled(a.data(), m, n, b.data(), p, c.data(), tile);
+        sink += c[0];
+    }), peak);
+}
+
+// Benchmark the small-matrix kernels on count independent N x N products
+template<std::size_t N>
+void benchmark_small(unsigned int count, double peak) {
+    std::vector<int> as(count * N * N);
+    std::vector<int> bs(count * N * N);
+    std::vector<int> cs(count * N * N);
+    for(unsigned int i = 0; i < as.size(); i++) {
+        as[i] = static_cast<int>(i % 7) - 3;
+        bs[i] = static_cast<int>(i % 5) - 2;
+    }
+
+    std::string shape = std::to_string(count) + " x " + std::to_string(N) + "x" + std::to_string(N);
+    double ops = 2.0 * count * N * N * N;
+
+    report(shape, "single", ops, time_per_call([&]() {
+        for(unsigned int i = 0; i < count; i++) {
+            int* multiplied = multiply(&as[i*N*N], N, N, &bs[i*N*N], N, N);
+            sink += multiplied[0];
+            delete[] multiplied;
+        }
+    }), peak);
+
+    typedef FixedMatrix<int, N, N> Matrix;
+    std::vector<Matrix> af(count);
+    std::vector<Matrix> bf(count);
+    std::vector<Matrix> cf(count);
+    for(unsigned int i = 0; i < count; i++) {
+        std::copy(&as[i*N*N], &as[(i + 1)*N*N], af[i].data);
+        std::copy(&bs[i*N*N], &bs[(i + 1)*N*N], bf[i].data);
+    }
+
+    report(shape, "fixed", ops, time_per_call([&]() {
+        for(unsigned int i = 0; i < count; i++) {
+            cf[i] = af[i] * bf[i];
+        }
+        sink += cf[0].data[0];
+    }), peak);
+
+    // The operands are interleaved once up front, as a caller of the batched
+    // API would keep them
+    std::vector<int> ai(interleaved_size(count, N, N));
+    std::vector<int> bi(interleaved_size(count, N, N));
+    std::vector<int> ci(interleaved_size(count, N, N));
+    interleave(as.data(), count, N, N, ai.data());
+    interleave(bs.data(), count, N, N, bi.data());
+
+    report(shape, "batched", ops, time_per_call([&]() {
+        multiply_batch(ai.data(), N, N, bi.data(), N, N, count, ci.data());
+        sink += ci[0];
+    }), peak);
+}
+
+int main(int argc, char* argv[]) {
+    const char* config = "matrix_multiply.conf";
+    bool retune = false;
+    unsigned int max_size = 512;
+    double peak = peak_gflops();
+
+    for(int i = 1; i < argc; i++) {
+        if(std::strcmp(argv[i], "--config") == 0 && i + 1 < argc) {
+            config = argv[++i];
+        }
+        else if(std::strcmp(argv[i], "--retune") == 0) {
+            retune = true;
+        }
+        else if(std::strcmp(argv[i], "--max-size") == 0 && i + 1 < argc) {
+            max_size = std::atoi(argv[++i]);
+        }
+        else if(std::strcmp(argv[i], "--peak") == 0 && i + 1 < argc) {
+            peak = std::atof(argv[++i]);
+        }
+        else {
+            std::cout << "Usage: " << argv[0]
+                      << " [--config <file>] [--retune] [--max-size <n>] [--peak <GFLOP/s>]" << std::endl;
+            return 1;
+        }
+    }
+
+    // Pick the tile size for this machine
+    unsigned int tile {};
+    try {
+        if(retune) {
+            tile = tune_tile(256);
+            save_tile(config, tile);
+        }
+        else {
+            tile = autotune_tile(config, 256);
+        }
+    }
+    catch(std::exception& e) {
+        std::cout << e.what() << std::endl;
+        tile = DEFAULT_TILE;
+    }
+    std::cout << "Tile size: " << tile << " (" << config << ")" << std::endl;
+    std::cout << "Peak:      ";
+    if(peak > 0.0) {
+        std::cout << std::fixed << std::setprecision(1) << peak << " GFLOP/s" << std::endl;
+    }
+    else {
+        std::cout << "unknown" << std::endl;
+    }
+    std::cout << std::endl;
+
+    std::cout << std::setw(24) << std::left << "Shape"
+              << std::setw(10) << "Kernel" << std::right
+              << std::setw(10) << "GFLOP/s"
+              << std::setw(10) << "Peak" << std::endl;
+
+    // Square, small inner dimension and large inner dimension products, all
+    // with the same number of operations for a given size
+    for(unsigned int size = 64; size <= max_size; size *= 2) {
+        benchmark_shape(size, size, size, tile, peak);
+        benchmark_shape(2 * size, size / 4, 2 * size, tile, peak);
+        benchmark_shape(size / 2, 4 * size, size / 2, tile, peak);
+    }
+
+    // Many small products
+    benchmark_small<3>(100000, peak);
+    benchmark_small<4>(100000, peak);
+}
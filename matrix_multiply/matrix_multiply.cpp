@@ -21,37 +21,20 @@
 //  - and results differ if I reorder the code
 //  - and it works correctly if I omit the delete
 
+#include <algorithm>    // For std::copy, std::equal
 #include <exception>    // For std::invalid_argument and std::logic_error
 #include <iomanip>      // For std::setw
 #include <iostream>     // For std::cout etc
+#include <string>       // For std::string
+#include <vector>       // For std::vector
 
-// Multiply two matrices
-int* multiply(int* a, unsigned int arows, unsigned int acols,
-              int* b, unsigned int brows, unsigned int bcols) {
-    if(!a || !arows || !acols || !b || !brows || !bcols ) {
-        throw(std::invalid_argument("multiply: bad arguments"));
-    }
+#include <stdlib.h>     // For mkstemp
+#include <unistd.h>     // For close, unlink
 
-    // Inner dimensions must match
-    if(acols != brows) {
-        throw(std::invalid_argument("multiply: inner dimensions mismatch"));
-    }
-
-    // Multiply the two matrices
-    int* multiplied = new int[arows * bcols]();
-    for(unsigned int m = 0; m < arows; m++) {
-        for(unsigned int p = 0; p < bcols; p++) {
-            for(unsigned int n = 0; n < acols; n++) {
-                multiplied[m*bcols + p] += a[m*acols + n] * b[n*bcols + p];
-            }
-        }
-    }
-
-    return multiplied;
-}
+#include "matrix_multiply.hpp"
 
 // Print a matrix
-void print(int* matrix, unsigned int rows, unsigned int cols) {
+void print(const int* matrix, unsigned int rows, unsigned int cols) {
     if(!matrix || !rows || !cols) {
         throw(std::invalid_argument("print: bad arguments"));
     }
@@ -100,6 +83,188 @@ void test(int* a,  unsigned int arows,  unsigned int acols,
     }
 }
 
+// Test multiplying a batch of matrices, each pair offset from a and b according
+// to its position in the batch, against multiplying them one at a time
+void test_batch(int* a, unsigned int arows, unsigned int acols,
+                int* b, unsigned int brows, unsigned int bcols,
+                unsigned int count) {
+    try {
+        // Build the batch as contiguous matrices, then interleave it
+        std::vector<int> as(count * arows * acols);
+        std::vector<int> bs(count * brows * bcols);
+        for(unsigned int i = 0; i < count; i++) {
+            for(unsigned int e = 0; e < arows * acols; e++) {
+                as[i*arows*acols + e] = a[e] + i % 3;
+            }
+            for(unsigned int e = 0; e < brows * bcols; e++) {
+                bs[i*brows*bcols + e] = b[e] + i % 3;
+            }
+        }
+
+        std::vector<int> ai(interleaved_size(count, arows, acols));
+        std::vector<int> bi(interleaved_size(count, brows, bcols));
+        std::vector<int> ci(interleaved_size(count, arows, bcols));
+        interleave(as.data(), count, arows, acols, ai.data());
+        interleave(bs.data(), count, brows, bcols, bi.data());
+
+        // Multiply the whole batch
+        multiply_batch(ai.data(), arows, acols, bi.data(), brows, bcols, count, ci.data());
+
+        std::vector<int> cs(count * arows * bcols);
+        deinterleave(ci.data(), count, arows, bcols, cs.data());
+
+        // Verify each result against a single multiplication
+        for(unsigned int i = 0; i < count; i++) {
+            int* multiplied = multiply(&as[i*arows*acols], arows, acols,
+                                       &bs[i*brows*bcols], brows, bcols);
+            for(unsigned int e = 0; e < arows * bcols; e++) {
+                if(multiplied[e] != cs[i*arows*bcols + e]) {
+                    delete[] multiplied;
+                    throw(std::logic_error("incorrect batched multiplication"));
+                }
+            }
+            delete[] multiplied;
+        }
+
+        std::cout << "Batch of " << count << " products of "
+                  << arows << "x" << acols << " and " << brows << "x" << bcols
+                  << " matrices:" << std::endl;
+        print(&cs[(count - 1)*arows*bcols], arows, bcols);
+        std::cout << std::endl;
+    }
+    catch(std::exception& e) {
+        std::cout << e.what() << std::endl;
+    }
+}
+
+// Test multiplying two matrices held in temporary files against multiply()
+void test_files(int* a, unsigned int arows, unsigned int acols,
+                int* b, unsigned int brows, unsigned int bcols,
+                unsigned int tile) {
+    char afile[] = "/tmp/matrix_multiply_a.XXXXXX";
+    char bfile[] = "/tmp/matrix_multiply_b.XXXXXX";
+    char cfile[] = "/tmp/matrix_multiply_c.XXXXXX";
+    close(mkstemp(afile));
+    close(mkstemp(bfile));
+    close(mkstemp(cfile));
+
+    try {
+        // Write the operands to their files
+        {
+            MappedMatrix ma(afile, arows, acols, true);
+            MappedMatrix mb(bfile, brows, bcols, true);
+            std::copy(a, a + arows*acols, ma.data());
+            std::copy(b, b + brows*bcols, mb.data());
+        }
+
+        // Multiply the files
+        multiply_files(afile, arows, acols, bfile, brows, bcols, cfile, tile);
+
+        // Verify the result was correct
+        int* multiplied = multiply(a, arows, acols, b, brows, bcols);
+        MappedMatrix mc(cfile, arows, bcols, false);
+        bool correct = std::equal(multiplied, multiplied + arows*bcols, mc.data());
+        delete[] multiplied;
+        if(!correct) {
+            throw(std::logic_error("incorrect file multiplication"));
+        }
+
+        std::cout << "Files " << arows << "x" << acols << " * " << brows << "x" << bcols
+                  << " with " << tile << "x" << tile << " tiles:" << std::endl;
+        if(arows * bcols <= 16) {
+            print(mc.data(), arows, bcols);
+        }
+        else {
+            std::cout << "  correct" << std::endl;
+        }
+        std::cout << std::endl;
+    }
+    catch(std::exception& e) {
+        std::cout << e.what() << std::endl;
+    }
+
+    unlink(afile);
+    unlink(bfile);
+    unlink(cfile);
+}
+
+// Test multiplying two matrices a tile at a time against multiply()
+void test_tiled(int* a, unsigned int arows, unsigned int acols,
+                int* b, unsigned int brows, unsigned int bcols,
+                unsigned int tile) {
+    try {
+        int* expected = multiply(a, arows, acols, b, brows, bcols);
+        std::vector<int> multiplied(arows * bcols);
+        multiply_tiled(a, arows, acols, b, bcols, multiplied.data(), tile);
+        bool correct = std::equal(multiplied.begin(), multiplied.end(), expected);
+        delete[] expected;
+        if(!correct) {
+            throw(std::logic_error("incorrect tiled multiplication"));
+        }
+
+        std::cout << "Tiled " << arows << "x" << acols << " * " << brows << "x" << bcols
+                  << " with " << tile << "x" << tile << " tiles:" << std::endl;
+        std::cout << "  correct" << std::endl;
+        std::cout << std::endl;
+    }
+    catch(std::exception& e) {
+        std::cout << e.what() << std::endl;
+    }
+}
+
+// Test multiplying a chain of matrices with the given dimensions, filled with
+// small values, against multiplying them left-to-right
+void test_chain(const std::vector<unsigned int>& dims) {
+    try {
+        // Create the matrices
+        std::vector<std::vector<int>> storage;
+        std::vector<const int*> matrices;
+        for(unsigned int i = 0; i + 1 < dims.size(); i++) {
+            storage.emplace_back(dims[i] * dims[i + 1]);
+            for(unsigned int e = 0; e < storage.back().size(); e++) {
+                storage.back()[e] = static_cast<int>((e + i) % 5) - 2;
+            }
+            matrices.push_back(storage.back().data());
+        }
+
+        // Multiply the chain
+        int* multiplied = multiply_chain(matrices, dims);
+
+        // Multiply left-to-right, counting the cost
+        unsigned long long cost = 0;
+        int* expected = new int[dims[0] * dims[1]];
+        std::copy(matrices[0], matrices[0] + dims[0]*dims[1], expected);
+        for(unsigned int i = 1; i < matrices.size(); i++) {
+            int* next = multiply(expected, dims[0], dims[i], const_cast<int*>(matrices[i]), dims[i], dims[i + 1]);
+            cost += static_cast<unsigned long long>(dims[0]) * dims[i] * dims[i + 1];
+            delete[] expected;
+            expected = next;
+        }
+
+        // Verify the result was correct
+        bool correct = std::equal(expected, expected + dims.front()*dims.back(), multiplied);
+        delete[] expected;
+        delete[] multiplied;
+        if(!correct) {
+            throw(std::logic_error("incorrect chain multiplication"));
+        }
+
+        ChainPlan plan = plan_chain(dims);
+        std::cout << "Chain";
+        for(unsigned int i = 0; i + 1 < dims.size(); i++) {
+            std::cout << (i ? " * " : " ") << dims[i] << "x" << dims[i + 1];
+        }
+        std::cout << ":" << std::endl;
+        std::cout << "  order " << parenthesize(plan, 0, plan.count - 1)
+                  << ", " << plan.cost << " multiplications"
+                  << " (" << cost << " left-to-right)" << std::endl;
+        std::cout << std::endl;
+    }
+    catch(std::exception& e) {
+        std::cout << e.what() << std::endl;
+    }
+}
+
 int main() {
     // Matrices
     int a[2][3] = {
@@ -177,4 +342,89 @@ int main() {
     test(reinterpret_cast<int*>(a),  2, 3,
          reinterpret_cast<int*>(b),  3, 0, // bad number of columns
          reinterpret_cast<int*>(ab), 2, 2);
+
+    // Test batched multiplication, including a partially filled last group
+    test_batch(reinterpret_cast<int*>(a), 2, 3,
+               reinterpret_cast<int*>(b), 3, 2, 19);
+
+    test_batch(reinterpret_cast<int*>(c), 2, 2,
+               reinterpret_cast<int*>(c), 2, 2, LANES);
+
+    // Test batched multiplication with bad arguments
+    test_batch(reinterpret_cast<int*>(a), 2, 3, // inner dimensions mismatch
+               reinterpret_cast<int*>(c), 2, 2, 4);
+
+    test_batch(reinterpret_cast<int*>(a), 2, 3, // empty batch
+               reinterpret_cast<int*>(b), 3, 2, 0);
+
+    // Test fixed-size multiplication, evaluated at compile time
+    constexpr FixedMatrix<int, 2, 3> fa {{ 1, 2, 3,
+                                           4, 5, 6 }};
+    constexpr FixedMatrix<int, 3, 2> fb {{ 1, 2,
+                                           3, 4,
+                                           5, 6 }};
+    constexpr FixedMatrix<int, 2, 2> fc {{ 1, 2,
+                                           3, 4 }};
+
+    constexpr FixedMatrix<int, 2, 2> fab = fa * fb;
+    constexpr FixedMatrix<int, 3, 3> fba = fb * fa;
+    constexpr FixedMatrix<int, 2, 2> fcc = fc * fc;
+
+    static_assert(equal(fab, FixedMatrix<int, 2, 2> {{ 22, 28, 49, 64 }}), "incorrect multiplication");
+    static_assert(equal(fba, FixedMatrix<int, 3, 3> {{ 9, 12, 15, 19, 26, 33, 29, 40, 51 }}), "incorrect multiplication");
+    static_assert(equal(fcc, FixedMatrix<int, 2, 2> {{ 7, 10, 15, 22 }}), "incorrect multiplication");
+
+    // Mismatched inner dimensions do not compile:
+    //  fa * fc;    // error: operator*: inner dimensions mismatch
+
+    std::cout << "Fixed-size Matrix 1 * Matrix 2:" << std::endl;
+    print(fab.data, 2, 2);
+    std::cout << std::endl;
+
+    // Test file-backed multiplication, with tiles smaller than, not dividing,
+    // and larger than the matrices
+    test_files(reinterpret_cast<int*>(a), 2, 3,
+               reinterpret_cast<int*>(b), 3, 2, 1);
+
+    test_files(reinterpret_cast<int*>(b), 3, 2,
+               reinterpret_cast<int*>(a), 2, 3, 2);
+
+    std::vector<int> d(37 * 53);
+    std::vector<int> e(53 * 29);
+    for(unsigned int i = 0; i < d.size(); i++) {
+        d[i] = static_cast<int>(i % 7) - 3;
+    }
+    for(unsigned int i = 0; i < e.size(); i++) {
+        e[i] = static_cast<int>(i % 5) - 2;
+    }
+    test_files(d.data(), 37, 53, e.data(), 53, 29, 8);
+    test_files(d.data(), 37, 53, e.data(), 53, 29, 64);
+
+    // A result much wider than the tiles, written a whole band of rows at a time
+    std::vector<int> f(53 * 1000);
+    for(unsigned int i = 0; i < f.size(); i++) {
+        f[i] = static_cast<int>(i % 11) - 5;
+    }
+    test_files(d.data(), 37, 53, f.data(), 53, 1000, 8);
+
+    // Test tiled multiplication
+    test_tiled(d.data(), 37, 53, e.data(), 53, 29, 8);
+    test_tiled(d.data(), 37, 53, e.data(), 53, 29, 64);
+
+    // Test file-backed multiplication with bad arguments
+    test_files(reinterpret_cast<int*>(a), 2, 3, // inner dimensions mismatch
+               reinterpret_cast<int*>(c), 2, 2, 2);
+
+    test_files(reinterpret_cast<int*>(a), 2, 3, // bad tile size
+               reinterpret_cast<int*>(b), 3, 2, 0);
+
+    // Test chain multiplication
+    test_chain({ 2, 3 });
+    test_chain({ 10, 100, 5, 50 });
+    test_chain({ 40, 20, 30, 10, 30 });
+    test_chain({ 30, 35, 15, 5, 10, 20, 25 });
+
+    // Test chain multiplication with bad arguments
+    test_chain({ 2 });          // no matrices
+    test_chain({ 2, 0, 3 });    // bad dimension
 }
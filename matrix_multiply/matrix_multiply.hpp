@@ -0,0 +1,637 @@
+// Multiply two matrices with dimensions m x n and n x p
+//
+// Kernels shared by the tests in matrix_multiply.cpp and the benchmark in
+// benchmark.cpp
+
+#ifndef MATRIX_MULTIPLY_H
+#define MATRIX_MULTIPLY_H
+
+#include <algorithm>    // For std::copy, std::fill, std::min
+#include <cerrno>       // For errno
+#include <chrono>       // For std::chrono::steady_clock
+#include <cstddef>      // For std::size_t
+#include <cstdlib>      // For std::strtoul
+#include <cstring>      // For std::strerror
+#include <exception>    // For std::invalid_argument
+#include <fstream>      // For std::ifstream, std::ofstream
+#include <limits>       // For std::numeric_limits
+#include <memory>       // For std::unique_ptr
+#include <stdexcept>    // For std::runtime_error
+#include <string>       // For std::string
+#include <vector>       // For std::vector
+
+#include <fcntl.h>      // For open
+#include <sys/mman.h>   // For mmap, madvise, msync
+#include <sys/stat.h>   // For fstat
+#include <unistd.h>     // For close, ftruncate, sysconf
+
+// Number of small matrices processed together by the batched multiply, one per
+// SIMD lane
+const unsigned int LANES = 8;
+
+// Multiply two matrices
+inline int* multiply(int* a, unsigned int arows, unsigned int acols,
+                     int* b, unsigned int brows, unsigned int bcols) {
+    if(!a || !arows || !acols || !b || !brows || !bcols ) {
+        throw(std::invalid_argument("multiply: bad arguments"));
+    }
+
+    // Inner dimensions must match
+    if(acols != brows) {
+        throw(std::invalid_argument("multiply: inner dimensions mismatch"));
+    }
+
+    // Multiply the two matrices
+    int* multiplied = new int[arows * bcols]();
+    for(unsigned int m = 0; m < arows; m++) {
+        for(unsigned int p = 0; p < bcols; p++) {
+            for(unsigned int n = 0; n < acols; n++) {
+                multiplied[m*bcols + p] += a[m*acols + n] * b[n*bcols + p];
+            }
+        }
+    }
+
+    return multiplied;
+}
+
+// Multiply two matrices into a caller-provided buffer of arows x bcols ints
+//
+// The arguments are not validated, that is up to the caller
+inline void multiply_into(const int* a, unsigned int arows, unsigned int acols,
+                          const int* b, unsigned int bcols, int* multiplied) {
+    std::fill(multiplied, multiplied + arows*bcols, 0);
+    for(unsigned int m = 0; m < arows; m++) {
+        for(unsigned int n = 0; n < acols; n++) {
+            for(unsigned int p = 0; p < bcols; p++) {
+                multiplied[m*bcols + p] += a[m*acols + n] * b[n*bcols + p];
+            }
+        }
+    }
+}
+
+// Multiply two matrices into a caller-provided buffer, a tile x tile block at a
+// time so that the blocks of a, b and the result being worked on stay in cache
+//
+// The arguments are not validated, that is up to the caller
+inline void multiply_tiled(const int* a, unsigned int arows, unsigned int acols,
+                           const int* b, unsigned int bcols, int* multiplied,
+                           unsigned int tile) {
+    std::fill(multiplied, multiplied + arows*bcols, 0);
+    for(unsigned int m0 = 0; m0 < arows; m0 += tile) {
+        unsigned int m1 = std::min(arows, m0 + tile);
+        for(unsigned int n0 = 0; n0 < acols; n0 += tile) {
+            unsigned int n1 = std::min(acols, n0 + tile);
+            for(unsigned int p0 = 0; p0 < bcols; p0 += tile) {
+                unsigned int p1 = std::min(bcols, p0 + tile);
+                for(unsigned int m = m0; m < m1; m++) {
+                    for(unsigned int n = n0; n < n1; n++) {
+                        int amn = a[m*acols + n];
+                        for(unsigned int p = p0; p < p1; p++) {
+                            multiplied[m*bcols + p] += amn * b[n*bcols + p];
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+// Number of ints needed to hold count interleaved matrices, rounded up to a
+// whole number of lanes
+inline unsigned int interleaved_size(unsigned int count, unsigned int rows, unsigned int cols) {
+    return ((count + LANES - 1) / LANES) * LANES * rows * cols;
+}
+
+// Interleave count contiguous matrices so that element (m, n) of each group of
+// LANES consecutive matrices is stored contiguously, one matrix per lane
+//
+// Unused lanes in the last group are zero-filled
+inline void interleave(const int* matrices, unsigned int count,
+                       unsigned int rows, unsigned int cols, int* interleaved) {
+    if(!matrices || !count || !rows || !cols || !interleaved) {
+        throw(std::invalid_argument("interleave: bad arguments"));
+    }
+
+    unsigned int elements = rows * cols;
+    unsigned int groups = (count + LANES - 1) / LANES;
+    for(unsigned int g = 0; g < groups; g++) {
+        for(unsigned int e = 0; e < elements; e++) {
+            for(unsigned int l = 0; l < LANES; l++) {
+                unsigned int i = g*LANES + l;
+                interleaved[(g*elements + e)*LANES + l] = (i < count) ? matrices[i*elements + e] : 0;
+            }
+        }
+    }
+}
+
+// Reverse interleave(), writing count contiguous matrices
+inline void deinterleave(const int* interleaved, unsigned int count,
+                         unsigned int rows, unsigned int cols, int* matrices) {
+    if(!interleaved || !count || !rows || !cols || !matrices) {
+        throw(std::invalid_argument("deinterleave: bad arguments"));
+    }
+
+    unsigned int elements = rows * cols;
+    for(unsigned int i = 0; i < count; i++) {
+        unsigned int g = i / LANES;
+        unsigned int l = i % LANES;
+        for(unsigned int e = 0; e < elements; e++) {
+            matrices[i*elements + e] = interleaved[(g*elements + e)*LANES + l];
+        }
+    }
+}
+
+// Multiply count pairs of small interleaved matrices
+//
+// The arguments are validated once for the whole batch and the results are
+// written to a caller-provided interleaved buffer of interleaved_size(count,
+// arows, bcols) ints, so there is no allocation per product. The innermost loop
+// runs across the lanes, i.e. across independent matrices, so the compiler can
+// vectorise it without any horizontal reductions
+inline void multiply_batch(const int* a, unsigned int arows, unsigned int acols,
+                           const int* b, unsigned int brows, unsigned int bcols,
+                           unsigned int count, int* multiplied) {
+    if(!a || !arows || !acols || !b || !brows || !bcols || !count || !multiplied) {
+        throw(std::invalid_argument("multiply_batch: bad arguments"));
+    }
+
+    // Inner dimensions must match
+    if(acols != brows) {
+        throw(std::invalid_argument("multiply_batch: inner dimensions mismatch"));
+    }
+
+    unsigned int groups = (count + LANES - 1) / LANES;
+    for(unsigned int g = 0; g < groups; g++) {
+        const int* ga = a + g*arows*acols*LANES;
+        const int* gb = b + g*brows*bcols*LANES;
+        int* gc = multiplied + g*arows*bcols*LANES;
+
+        for(unsigned int m = 0; m < arows; m++) {
+            for(unsigned int p = 0; p < bcols; p++) {
+                int sum[LANES] = {};
+                for(unsigned int n = 0; n < acols; n++) {
+                    const int* x = ga + (m*acols + n)*LANES;
+                    const int* y = gb + (n*bcols + p)*LANES;
+                    for(unsigned int l = 0; l < LANES; l++) {
+                        sum[l] += x[l] * y[l];
+                    }
+                }
+                for(unsigned int l = 0; l < LANES; l++) {
+                    gc[(m*bcols + p)*LANES + l] = sum[l];
+                }
+            }
+        }
+    }
+}
+
+// A matrix with dimensions R x C known at compile time
+//
+// This is an aggregate, so it can be brace-initialised and used in constant
+// expressions e.g.
+//  constexpr FixedMatrix<int, 2, 2> c {{ 1, 2,
+//                                        3, 4 }};
+template<typename T, std::size_t R, std::size_t C>
+struct FixedMatrix {
+    T data[R * C];
+
+    constexpr T operator()(std::size_t m, std::size_t n) const {
+        return data[m*C + n];
+    }
+};
+
+// A compile-time list of indices 0..N-1, used to expand the product one
+// element at a time (std::index_sequence is not available in C++11)
+template<std::size_t... I>
+struct Indices {};
+
+template<std::size_t N, std::size_t... I>
+struct MakeIndices : MakeIndices<N - 1, N - 1, I...> {};
+
+template<std::size_t... I>
+struct MakeIndices<0, I...> {
+    typedef Indices<I...> type;
+};
+
+// The sum of a(m, k) * b(k, p) for k = 0..K-1, unrolled at compile time
+template<std::size_t K>
+struct Dot {
+    template<typename T, std::size_t R, std::size_t N, std::size_t C>
+    static constexpr T apply(const FixedMatrix<T, R, N>& a, const FixedMatrix<T, N, C>& b,
+                             std::size_t m, std::size_t p) {
+        return Dot<K - 1>::apply(a, b, m, p) + a(m, K - 1) * b(K - 1, p);
+    }
+};
+
+template<>
+struct Dot<0> {
+    template<typename T, std::size_t R, std::size_t N, std::size_t C>
+    static constexpr T apply(const FixedMatrix<T, R, N>&, const FixedMatrix<T, N, C>&,
+                             std::size_t, std::size_t) {
+        return T();
+    }
+};
+
+// Expand every element of the product from its index
+template<typename T, std::size_t R, std::size_t N, std::size_t C, std::size_t... I>
+constexpr FixedMatrix<T, R, C> multiply(const FixedMatrix<T, R, N>& a,
+                                        const FixedMatrix<T, N, C>& b,
+                                        Indices<I...>) {
+    return FixedMatrix<T, R, C> {{ Dot<N>::apply(a, b, I / C, I % C)... }};
+}
+
+// Multiply two fixed-size matrices
+//
+// The loops are unrolled into straight-line code and the product can be
+// evaluated at compile time. Unlike multiply() above, mismatched inner
+// dimensions are a compile-time error rather than std::invalid_argument
+template<typename T, std::size_t R, std::size_t N1, std::size_t N2, std::size_t C>
+constexpr FixedMatrix<T, R, C> operator*(const FixedMatrix<T, R, N1>& a,
+                                         const FixedMatrix<T, N2, C>& b) {
+    static_assert(N1 == N2, "operator*: inner dimensions mismatch");
+    return multiply(a, b, typename MakeIndices<R * C>::type {});
+}
+
+// Are two fixed-size matrices equal, comparing from element i onwards?
+template<typename T, std::size_t R, std::size_t C>
+constexpr bool equal(const FixedMatrix<T, R, C>& a, const FixedMatrix<T, R, C>& b,
+                     std::size_t i = 0) {
+    return (i == R * C) || ((a.data[i] == b.data[i]) && equal(a, b, i + 1));
+}
+
+// A binary file of rows x cols ints in row-major order, memory-mapped so that
+// it need not fit in RAM
+class MappedMatrix {
+public:
+    MappedMatrix(const char* path, unsigned int rows, unsigned int cols, bool create);
+    ~MappedMatrix();
+
+    int* data() const { return matrix; }
+    void prefetch(unsigned int row, unsigned int nrows) const;  // ask the kernel to start reading rows in the background
+    void release(unsigned int row, unsigned int nrows) const;   // rows are no longer needed, start writeback and drop them
+
+private:
+    MappedMatrix(const MappedMatrix&) = delete;
+    MappedMatrix& operator=(const MappedMatrix&) = delete;
+
+    void advise(unsigned int row, unsigned int nrows, int advice) const;
+
+    unsigned int cols;
+    std::size_t length;
+    int fd;
+    int* matrix;
+};
+
+// Map an existing file, or create a zero-filled file, of rows x cols ints
+inline MappedMatrix::MappedMatrix(const char* path, unsigned int rows, unsigned int cols, bool create)
+    : cols(cols), length(static_cast<std::size_t>(rows) * cols * sizeof(int)), fd(-1), matrix(nullptr) {
+    fd = create ? open(path, O_RDWR | O_CREAT | O_TRUNC, 0644) : open(path, O_RDONLY);
+    if(fd < 0) {
+        throw(std::runtime_error(std::string("MappedMatrix: ") + path + ": " + std::strerror(errno)));
+    }
+
+    struct stat st {};
+    if((create && ftruncate(fd, length) != 0) || fstat(fd, &st) != 0) {
+        int error = errno;
+        close(fd);
+        throw(std::runtime_error(std::string("MappedMatrix: ") + path + ": " + std::strerror(error)));
+    }
+    if(static_cast<std::size_t>(st.st_size) != length) {
+        close(fd);
+        throw(std::invalid_argument(std::string("MappedMatrix: ") + path + ": size does not match dimensions"));
+    }
+
+    void* mapped = mmap(nullptr, length, create ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+    if(mapped == MAP_FAILED) {
+        int error = errno;
+        close(fd);
+        throw(std::runtime_error(std::string("MappedMatrix: ") + path + ": " + std::strerror(error)));
+    }
+    matrix = static_cast<int*>(mapped);
+}
+
+// Unmap and close the file, any changes are written back by the kernel
+inline MappedMatrix::~MappedMatrix() {
+    munmap(matrix, length);
+    close(fd);
+}
+
+// Apply advice to the pages holding rows row..row+nrows-1
+inline void MappedMatrix::advise(unsigned int row, unsigned int nrows, int advice) const {
+    static const std::size_t page = sysconf(_SC_PAGESIZE);
+
+    std::size_t begin = static_cast<std::size_t>(row) * cols * sizeof(int);
+    std::size_t end = std::min(length, begin + static_cast<std::size_t>(nrows) * cols * sizeof(int));
+    if(begin >= end) {
+        return;
+    }
+
+    // madvise needs a page-aligned address
+    begin -= begin % page;
+    char* start = reinterpret_cast<char*>(matrix) + begin;
+    if(advice == MADV_DONTNEED) {
+        msync(start, end - begin, MS_ASYNC);
+    }
+    madvise(start, end - begin, advice);
+}
+
+// Ask the kernel to start reading rows in the background
+inline void MappedMatrix::prefetch(unsigned int row, unsigned int nrows) const {
+    advise(row, nrows, MADV_WILLNEED);
+}
+
+// Rows are no longer needed, start writeback and drop them from this process
+inline void MappedMatrix::release(unsigned int row, unsigned int nrows) const {
+    advise(row, nrows, MADV_DONTNEED);
+}
+
+// Multiply two matrices held in binary files, writing the result to a file
+//
+// The product is computed in tile x tile blocks. Each band of tile rows of the
+// result is finished before moving on, so a and the result are each streamed
+// from and to disk exactly once, and b is streamed once per band. While one
+// block is being multiplied the kernel is already reading the next band of b
+// (and the next band of a) in the background
+//
+// The band of the result being computed, tile x bcols ints, is accumulated in
+// memory and copied to the file in one contiguous run once it is finished, so
+// each page of the result is written once and in order rather than being
+// updated a tile-wide strip of each row at a time
+inline void multiply_files(const char* afile, unsigned int arows, unsigned int acols,
+                           const char* bfile, unsigned int brows, unsigned int bcols,
+                           const char* multipliedfile, unsigned int tile) {
+    if(!afile || !arows || !acols || !bfile || !brows || !bcols || !multipliedfile || !tile) {
+        throw(std::invalid_argument("multiply_files: bad arguments"));
+    }
+
+    // Inner dimensions must match
+    if(acols != brows) {
+        throw(std::invalid_argument("multiply_files: inner dimensions mismatch"));
+    }
+
+    MappedMatrix ma(afile, arows, acols, false);
+    MappedMatrix mb(bfile, brows, bcols, false);
+    MappedMatrix mc(multipliedfile, arows, bcols, true);
+    const int* a = ma.data();
+    const int* b = mb.data();
+    int* c = mc.data();
+
+    std::vector<int> panel(static_cast<std::size_t>(std::min(arows, tile)) * bcols);
+
+    ma.prefetch(0, tile);
+    mb.prefetch(0, tile);
+    for(unsigned int m0 = 0; m0 < arows; m0 += tile) {
+        unsigned int m1 = std::min(arows, m0 + tile);
+        std::fill(panel.begin(), panel.end(), 0);
+
+        for(unsigned int n0 = 0; n0 < acols; n0 += tile) {
+            unsigned int n1 = std::min(acols, n0 + tile);
+
+            // Prefetch the next band of b, or the next band of a and the
+            // first band of b again when this band of the result is done
+            if(n1 < acols) {
+                mb.prefetch(n1, tile);
+            }
+            else {
+                ma.prefetch(m1, tile);
+                mb.prefetch(0, tile);
+            }
+
+            for(unsigned int p0 = 0; p0 < bcols; p0 += tile) {
+                unsigned int p1 = std::min(bcols, p0 + tile);
+
+                // Multiply one block, with the innermost loop running along
+                // rows of b and the result
+                for(unsigned int m = m0; m < m1; m++) {
+                    int* cm = panel.data() + static_cast<std::size_t>(m - m0) * bcols;
+                    for(unsigned int n = n0; n < n1; n++) {
+                        int am = a[static_cast<std::size_t>(m) * acols + n];
+                        const int* bn = b + static_cast<std::size_t>(n) * bcols;
+                        for(unsigned int p = p0; p < p1; p++) {
+                            cm[p] += am * bn[p];
+                        }
+                    }
+                }
+            }
+        }
+
+        // Write out this band of the result, then a and the result are
+        // finished with
+        std::copy(panel.begin(), panel.begin() + static_cast<std::size_t>(m1 - m0) * bcols,
+                  c + static_cast<std::size_t>(m0) * bcols);
+        ma.release(m0, tile);
+        mc.release(m0, tile);
+    }
+}
+
+// The cheapest order in which to multiply a chain of matrices
+struct ChainPlan {
+    unsigned int count;                 // number of matrices in the chain
+    unsigned long long cost;            // number of scalar multiplications
+    std::vector<unsigned int> split;    // split[i*count + j] = k: multiply i..k by k+1..j
+};
+
+// Find the cheapest order in which to multiply a chain of matrices, where
+// matrix i has dimensions dims[i] x dims[i+1]
+//
+// This is the classic O(n^3) dynamic programme over the cost of every
+// sub-chain i..j
+inline ChainPlan plan_chain(const std::vector<unsigned int>& dims) {
+    if(dims.size() < 2) {
+        throw(std::invalid_argument("plan_chain: bad arguments"));
+    }
+
+    unsigned int count = dims.size() - 1;
+    std::vector<unsigned long long> cost(count * count, 0);
+    ChainPlan plan { count, 0, std::vector<unsigned int>(count * count, 0) };
+
+    for(unsigned int length = 2; length <= count; length++) {
+        for(unsigned int i = 0; i + length <= count; i++) {
+            unsigned int j = i + length - 1;
+            cost[i*count + j] = std::numeric_limits<unsigned long long>::max();
+            for(unsigned int k = i; k < j; k++) {
+                unsigned long long c = cost[i*count + k] + cost[(k + 1)*count + j] +
+                    static_cast<unsigned long long>(dims[i]) * dims[k + 1] * dims[j + 1];
+                if(c < cost[i*count + j]) {
+                    cost[i*count + j] = c;
+                    plan.split[i*count + j] = k;
+                }
+            }
+        }
+    }
+
+    plan.cost = cost[count - 1];
+    return plan;
+}
+
+// Describe the order of a plan for matrices i..j e.g. "((AB)C)"
+inline std::string parenthesize(const ChainPlan& plan, unsigned int i, unsigned int j) {
+    if(i == j) {
+        return std::string(1, static_cast<char>('A' + i % 26));
+    }
+    unsigned int k = plan.split[i*plan.count + j];
+    return "(" + parenthesize(plan, i, k) + parenthesize(plan, k + 1, j) + ")";
+}
+
+// Scratch buffers for intermediate products, reused between steps of a chain
+class ChainScratch {
+public:
+    ChainScratch(std::size_t size) : size(size) {}
+
+    int* acquire();             // get a free buffer, allocating one if necessary
+    void release(int* buffer);  // return a buffer for reuse
+
+private:
+    std::size_t size;
+    std::vector<std::unique_ptr<int[]>> buffers;
+    std::vector<int*> available;
+};
+
+// Get a free buffer, allocating one if necessary
+inline int* ChainScratch::acquire() {
+    if(available.empty()) {
+        buffers.emplace_back(new int[size]);
+        return buffers.back().get();
+    }
+    int* buffer = available.back();
+    available.pop_back();
+    return buffer;
+}
+
+// Return a buffer for reuse
+inline void ChainScratch::release(int* buffer) {
+    available.push_back(buffer);
+}
+
+// Multiply matrices i..j in the planned order, into multiplied if given or
+// else into a scratch buffer
+inline const int* evaluate_chain(const std::vector<const int*>& matrices, const std::vector<unsigned int>& dims,
+                                 const ChainPlan& plan, ChainScratch& scratch,
+                                 unsigned int i, unsigned int j, int* multiplied) {
+    if(i == j) {
+        if(multiplied) {
+            std::copy(matrices[i], matrices[i] + dims[i]*dims[i + 1], multiplied);
+            return multiplied;
+        }
+        return matrices[i];
+    }
+
+    unsigned int k = plan.split[i*plan.count + j];
+    const int* left = evaluate_chain(matrices, dims, plan, scratch, i, k, nullptr);
+    const int* right = evaluate_chain(matrices, dims, plan, scratch, k + 1, j, nullptr);
+
+    int* result = multiplied ? multiplied : scratch.acquire();
+    multiply_into(left, dims[i], dims[k + 1], right, dims[j + 1], result);
+
+    // Intermediate products are finished with once consumed
+    if(i < k) {
+        scratch.release(const_cast<int*>(left));
+    }
+    if(k + 1 < j) {
+        scratch.release(const_cast<int*>(right));
+    }
+    return result;
+}
+
+// Multiply a chain of matrices, where matrix i has dimensions dims[i] x dims[i+1]
+//
+// The multiplications are done in the cheapest order found by plan_chain(), and
+// the intermediate products share a small pool of scratch buffers. As with
+// multiply() the caller must delete[] the result
+inline int* multiply_chain(const std::vector<const int*>& matrices, const std::vector<unsigned int>& dims) {
+    if(matrices.empty() || dims.size() != matrices.size() + 1) {
+        throw(std::invalid_argument("multiply_chain: bad arguments"));
+    }
+    for(unsigned int i = 0; i < matrices.size(); i++) {
+        if(!matrices[i] || !dims[i] || !dims[i + 1]) {
+            throw(std::invalid_argument("multiply_chain: bad arguments"));
+        }
+    }
+
+    ChainPlan plan = plan_chain(dims);
+
+    // Every intermediate product fits in the largest possible one
+    std::size_t largest = 0;
+    for(unsigned int i = 0; i < plan.count; i++) {
+        for(unsigned int j = i + 1; j < plan.count; j++) {
+            largest = std::max(largest, static_cast<std::size_t>(dims[i]) * dims[j + 1]);
+        }
+    }
+    ChainScratch scratch(largest);
+
+    int* multiplied = new int[dims.front() * dims.back()];
+    evaluate_chain(matrices, dims, plan, scratch, 0, plan.count - 1, multiplied);
+    return multiplied;
+}
+
+// Tile size used when there is no saved configuration and no time to tune
+const unsigned int DEFAULT_TILE = 64;
+
+// Read the tile size from a configuration file of the form "tile=64"
+//
+// Returns 0 if the file does not exist or does not hold a valid tile size
+inline unsigned int load_tile(const char* config) {
+    std::ifstream in(config);
+    std::string line;
+    while(std::getline(in, line)) {
+        if(line.compare(0, 5, "tile=") == 0) {
+            unsigned long tile = std::strtoul(line.c_str() + 5, nullptr, 10);
+            return (tile > 0 && tile <= 4096) ? tile : 0;
+        }
+    }
+    return 0;
+}
+
+// Save the tile size to a configuration file
+inline void save_tile(const char* config, unsigned int tile) {
+    std::ofstream out(config);
+    out << "tile=" << tile << std::endl;
+    if(!out) {
+        throw(std::runtime_error(std::string("save_tile: ") + config + ": cannot write"));
+    }
+}
+
+// Pick the fastest tile size for multiply_tiled() on this machine
+//
+// The candidates are the powers of two for which the three blocks being worked
+// on fit in the level 2 cache (or 256KB if its size is unknown), each timed on
+// a size x size product
+inline unsigned int tune_tile(unsigned int size) {
+    long cache = sysconf(_SC_LEVEL2_CACHE_SIZE);
+    if(cache <= 0) {
+        cache = 256 * 1024;
+    }
+
+    std::vector<int> a(size * size);
+    std::vector<int> b(size * size);
+    std::vector<int> c(size * size);
+    for(unsigned int i = 0; i < a.size(); i++) {
+        a[i] = static_cast<int>(i % 7) - 3;
+        b[i] = static_cast<int>(i % 5) - 2;
+    }
+
+    unsigned int best = DEFAULT_TILE;
+    double fastest = std::numeric_limits<double>::max();
+    for(unsigned int tile = 8; tile <= size && 3 * tile * tile * sizeof(int) <= static_cast<unsigned long>(cache); tile *= 2) {
+        auto start = std::chrono::steady_clock::now();
+        multiply_tiled(a.data(), size, size, b.data(), size, c.data(), tile);
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        if(elapsed.count() < fastest) {
+            fastest = elapsed.count();
+            best = tile;
+        }
+    }
+    return best;
+}
+
+// Get the tile size for this machine from a configuration file, tuning and
+// saving it first if the file does not exist yet
+inline unsigned int autotune_tile(const char* config, unsigned int size) {
+    unsigned int tile = load_tile(config);
+    if(!tile) {
+        tile = tune_tile(size);
+        save_tile(config, tile);
+    }
+    return tile;
+}
+
+#endif
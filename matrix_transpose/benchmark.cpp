@@ -0,0 +1,124 @@
+// Benchmark the matrix transpose kernels
+//
+// Usage: benchmark [<rows> [<cols>]]
+//
+// Transposes a rows x cols matrix, 8192 x 8192 by default, with each kernel and
+// reports the time taken and the effective bandwidth, counting one read and one
+// write of every element. Kernels that allocate their result, such as
+// transpose(), include the cost of the allocation and page faults.
+
+#include <algorithm>    // For std::max, std::min, std::swap
+#include <chrono>       // For std::chrono::steady_clock
+#include <cstdlib>      // For std::atoi
+#include <cstring>      // For std::memcpy
+#include <iomanip>      // For std::setw, std::setprecision
+#include <iostream>     // For std::cout etc
+#include <string>       // For std::string
+#include <thread>       // For std::thread
+#include <vector>       // For std::vector
+
+#include "matrix_transpose.hpp"
+
+// Keep results alive so that the compiler cannot optimise the work away
+volatile int sink = 0;
+
+// The original row-by-row loop, for reference
+void transpose_loop(const int* matrix, unsigned int rows, unsigned int cols, int* transposed) {
+    for(unsigned int m = 0; m < rows; m++) {
+        for(unsigned int n = 0; n < cols; n++) {
+            transposed[n*rows + m] = matrix[m*cols + n];
+        }
+    }
+}
+
+// Time a function, repeating it until at least 1s has elapsed, and return the
+// average number of seconds per call
+template<typename F>
+double time_per_call(F f) {
+    unsigned int calls = 0;
+    std::chrono::duration<double> elapsed {};
+    auto start = std::chrono::steady_clock::now();
+    do {
+        f();
+        calls++;
+        elapsed = std::chrono::steady_clock::now() - start;
+    } while(elapsed.count() < 1.0);
+    return elapsed.count() / calls;
+}
+
+// Print one result
+void report(const std::string& kernel, double bytes, double seconds) {
+    std::cout << std::setw(12) << std::left << kernel << std::right
+              << std::setw(10) << std::fixed << std::setprecision(1) << seconds * 1e3 << " ms"
+              << std::setw(10) << std::setprecision(2) << bytes / seconds / 1e9 << " GB/s" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    unsigned int rows = (argc > 1) ? std::atoi(argv[1]) : 8192;
+    unsigned int cols = (argc > 2) ? std::atoi(argv[2]) : rows;
+    if(!rows || !cols) {
+        std::cout << "Usage: " << argv[0] << " [<rows> [<cols>]]" << std::endl;
+        return 1;
+    }
+
+    std::vector<int> matrix(static_cast<std::size_t>(rows) * cols);
+    for(std::size_t i = 0; i < matrix.size(); i++) {
+        matrix[i] = i;
+    }
+    std::vector<int> transposed(matrix.size());
+    double bytes = 2.0 * matrix.size() * sizeof(int);
+
+    std::cout << "Transpose " << rows << "x" << cols << ":" << std::endl;
+
+    // Copying is the upper bound on transpose bandwidth
+    report("memcpy", bytes, time_per_call([&]() {
+        std::memcpy(transposed.data(), matrix.data(), matrix.size() * sizeof(int));
+        sink += transposed[1];
+    }));
+
+    report("loop", bytes, time_per_call([&]() {
+        transpose_loop(matrix.data(), rows, cols, transposed.data());
+        sink += transposed[1];
+    }));
+
+    report("blocked", bytes, time_per_call([&]() {
+        transpose_into(matrix.data(), rows, cols, transposed.data());
+        sink += transposed[1];
+    }));
+
+    report("transpose", bytes, time_per_call([&]() {
+        int* result = transpose(matrix.data(), rows, cols);
+        sink += result[1];
+        delete[] result;
+    }));
+
+    report("recursive", bytes, time_per_call([&]() {
+        transpose_recursive(matrix.data(), rows, cols, transposed.data());
+        sink += transposed[1];
+    }));
+
+    // Scaling with the number of threads, up to the number of hardware threads.
+    // Like transpose(), each call allocates a fresh result so that its pages
+    // are first touched by the threads that write them
+    unsigned int hardware = std::max(1u, std::thread::hardware_concurrency());
+    for(unsigned int nthreads = 1; ; nthreads = std::min(2 * nthreads, hardware)) {
+        report("parallel x" + std::to_string(nthreads), bytes, time_per_call([&]() {
+            int* result = transpose_parallel(matrix.data(), rows, cols, nthreads);
+            sink += result[1];
+            delete[] result;
+        }));
+        if(nthreads == hardware) {
+            break;
+        }
+    }
+
+    // Each call transposes the result of the previous one in place
+    std::vector<int> in_place(matrix);
+    unsigned int in_place_rows = rows;
+    unsigned int in_place_cols = cols;
+    report("in-place", bytes, time_per_call([&]() {
+        transpose_in_place(in_place.data(), in_place_rows, in_place_cols);
+        std::swap(in_place_rows, in_place_cols);
+        sink += in_place[1];
+    }));
+}
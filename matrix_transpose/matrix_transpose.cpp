@@ -1,26 +1,19 @@
 // Transpose a matrix with dimensions m x n to dimensions n x m
 
+#include <algorithm>    // For std::equal
 #include <exception>    // For std::invalid_argument etc
 #include <iomanip>      // For std::setw
 #include <iostream>     // For std::cout etc
+#include <vector>       // For std::vector
 
-// Transpose a matrix
-int* transpose(int* matrix, unsigned int rows, unsigned int cols) {
-    if(!matrix || !rows || !cols) {
-        throw(std::invalid_argument("transpose: bad arguments"));
-    }
+#include <fcntl.h>      // For open
+#include <stdlib.h>     // For mkstemp
+#include <unistd.h>     // For close, unlink
 
-    int* transposed = new int[rows*cols];
-    for(unsigned int m = 0; m < rows; m++) {
-        for(unsigned int n = 0; n < cols; n++) {
-            transposed[n*rows +m] = matrix[m*cols + n];
-        }
-    }
-    return transposed;
-}
+#include "matrix_transpose.hpp"
 
 // Print a matrix
-void print(int* matrix, unsigned int rows, unsigned int cols) {
+void print(const int* matrix, unsigned int rows, unsigned int cols) {
     if(!matrix || !rows || !cols) {
         throw(std::invalid_argument("print: bad arguments"));
     }
@@ -46,13 +39,184 @@ void test(int* matrix, unsigned int rows, unsigned int cols) {
         print(transposed, cols, rows);
         std::cout << std::endl;
 
+        // Verify the recursive transpose gives the same result
+        std::vector<int> recursive(rows*cols);
+        transpose_recursive(matrix, rows, cols, recursive.data());
+        bool correct = std::equal(recursive.begin(), recursive.end(), transposed);
         delete[] transposed;
+        if(!correct) {
+            throw(std::logic_error("incorrect recursive transpose"));
+        }
     }
     catch(std::exception& e) {
         std::cout << e.what() << std::endl;
     }
 }
 
+// Test transposing a large rows x cols matrix recursively against transpose()
+void test_recursive(unsigned int rows, unsigned int cols) {
+    try {
+        std::vector<int> matrix(rows*cols);
+        for(unsigned int i = 0; i < matrix.size(); i++) {
+            matrix[i] = i;
+        }
+
+        int* transposed = transpose(matrix.data(), rows, cols);
+        std::vector<int> recursive(rows*cols);
+        transpose_recursive(matrix.data(), rows, cols, recursive.data());
+        bool correct = std::equal(recursive.begin(), recursive.end(), transposed);
+        delete[] transposed;
+        if(!correct) {
+            throw(std::logic_error("incorrect recursive transpose"));
+        }
+
+        std::cout << "Recursive transpose of " << rows << "x" << cols << ": correct" << std::endl;
+    }
+    catch(std::exception& e) {
+        std::cout << e.what() << std::endl;
+    }
+}
+
+// Test transposing a rows x cols matrix in place against transpose()
+void test_in_place(unsigned int rows, unsigned int cols) {
+    try {
+        std::vector<int> matrix(rows*cols);
+        for(unsigned int i = 0; i < matrix.size(); i++) {
+            matrix[i] = i;
+        }
+
+        std::vector<int> original(matrix);
+        transpose_in_place(matrix.data(), rows, cols);
+        int* transposed = transpose(original.data(), rows, cols);
+        bool correct = std::equal(matrix.begin(), matrix.end(), transposed);
+        delete[] transposed;
+        if(!correct) {
+            throw(std::logic_error("incorrect in-place transpose"));
+        }
+
+        std::cout << "In-place transpose of " << rows << "x" << cols << ": correct" << std::endl;
+        if(rows * cols <= 16) {
+            print(matrix.data(), cols, rows);
+        }
+    }
+    catch(std::exception& e) {
+        std::cout << e.what() << std::endl;
+    }
+}
+
+// Test transposing a rows x cols matrix with several threads against transpose()
+void test_parallel(unsigned int rows, unsigned int cols, unsigned int nthreads) {
+    try {
+        std::vector<int> matrix(rows*cols);
+        for(unsigned int i = 0; i < matrix.size(); i++) {
+            matrix[i] = i;
+        }
+
+        int* parallel = transpose_parallel(matrix.data(), rows, cols, nthreads);
+        int* transposed = transpose(matrix.data(), rows, cols);
+        bool correct = std::equal(transposed, transposed + rows*cols, parallel);
+        delete[] transposed;
+        delete[] parallel;
+        if(!correct) {
+            throw(std::logic_error("incorrect parallel transpose"));
+        }
+
+        std::cout << "Parallel transpose of " << rows << "x" << cols
+                  << " with " << nthreads << " threads: correct" << std::endl;
+    }
+    catch(std::exception& e) {
+        std::cout << e.what() << std::endl;
+    }
+}
+
+// Test multiplying every combination of a matrix and its transposed view
+// against multiplying explicitly transposed copies
+void test_views(int* matrix, unsigned int rows, unsigned int cols) {
+    try {
+        std::vector<int> transposed(rows*cols);
+        transpose_into(matrix, rows, cols, transposed.data());
+        MatrixView a = view(matrix, rows, cols);
+        MatrixView t = view(transposed.data(), cols, rows);
+
+        // Each product using views, with the same product using copies
+        struct {
+            const char* name;
+            MatrixView lhs;
+            MatrixView rhs;
+            MatrixView lhs_copy;
+            MatrixView rhs_copy;
+        } products[] = {
+            { "M * M'",  a,              a.transposed(), a, t },
+            { "M' * M",  a.transposed(), a,              t, a },
+            { "M' * M'", a.transposed(), a.transposed(), t, t },
+            { "M * M",   a,              a,              a, a }
+        };
+
+        for(auto& product : products) {
+            std::vector<int> multiplied(product.lhs.rows * product.rhs.cols);
+            multiply(product.lhs, product.rhs, multiplied.data());
+
+            std::vector<int> expected(product.lhs.rows * product.rhs.cols);
+            for(unsigned int m = 0; m < product.lhs.rows; m++) {
+                for(unsigned int p = 0; p < product.rhs.cols; p++) {
+                    for(unsigned int n = 0; n < product.lhs.cols; n++) {
+                        expected[m*product.rhs.cols + p] += product.lhs_copy(m, n) * product.rhs_copy(n, p);
+                    }
+                }
+            }
+            if(multiplied != expected) {
+                throw(std::logic_error("incorrect multiplication of views"));
+            }
+
+            std::cout << product.name << " using views:" << std::endl;
+            print(multiplied.data(), product.lhs.rows, product.rhs.cols);
+            std::cout << std::endl;
+        }
+    }
+    catch(std::exception& e) {
+        std::cout << e.what() << std::endl;
+    }
+}
+
+// Test transposing a rows x cols matrix from one temporary file to another,
+// using at most about memory bytes, against transpose()
+void test_file(unsigned int rows, unsigned int cols, std::size_t memory) {
+    char infile[] = "/tmp/matrix_transpose_in.XXXXXX";
+    char outfile[] = "/tmp/matrix_transpose_out.XXXXXX";
+    int in = mkstemp(infile);
+    int out = mkstemp(outfile);
+
+    try {
+        std::vector<int> matrix(rows*cols);
+        for(unsigned int i = 0; i < matrix.size(); i++) {
+            matrix[i] = i;
+        }
+        write_fully(in, matrix.data(), matrix.size() * sizeof(int), 0);
+
+        transpose_file(in, out, rows, cols, memory);
+
+        std::vector<int> streamed(rows*cols);
+        read_fully(out, streamed.data(), streamed.size() * sizeof(int), 0);
+        int* transposed = transpose(matrix.data(), rows, cols);
+        bool correct = std::equal(streamed.begin(), streamed.end(), transposed);
+        delete[] transposed;
+        if(!correct) {
+            throw(std::logic_error("incorrect file transpose"));
+        }
+
+        std::cout << "File transpose of " << rows << "x" << cols
+                  << " in " << memory << " bytes: correct" << std::endl;
+    }
+    catch(std::exception& e) {
+        std::cout << e.what() << std::endl;
+    }
+
+    close(in);
+    close(out);
+    unlink(infile);
+    unlink(outfile);
+}
+
 int main() {
     int a[2][4] = {
         { 1, 2, 3, 4 },
@@ -81,4 +245,59 @@ int main() {
     test(nullptr, 2, 4);
     test(reinterpret_cast<int*>(a), 0, 4);
     test(reinterpret_cast<int*>(a), 2, 0);
+
+    // Test transposing larger matrices recursively, with dimensions above and
+    // below the base case and not powers of two
+    test_recursive(1, 100);
+    test_recursive(100, 1);
+    test_recursive(17, 33);
+    test_recursive(257, 129);
+    test_recursive(300, 300);
+
+    // Test matrices large enough for the result to be written with streaming
+    // stores, with rows that are a multiple of 16 but not of the tile size
+    test_recursive(1040, 333);
+    test_recursive(16, 20000);
+
+    // Test transposing in place, both square and rectangular
+    test_in_place(2, 4);
+    test_in_place(3, 3);
+    test_in_place(1, 7);
+    test_in_place(37, 53);
+    test_in_place(100, 100);
+    test_in_place(256, 64);
+
+    // Test transposing in place with bad arguments
+    test_in_place(0, 4);
+
+    // Test transposing with several threads, including more threads than
+    // pages to share out and bands that start and end part way through rows
+    test_parallel(2, 4, 1);
+    test_parallel(300, 517, 3);
+    test_parallel(1000, 1000, 4);
+    test_parallel(100, 100, 8);
+    test_parallel(1027, 61, 5);
+    test_parallel(1024, 1024, 3);
+
+    // Test transposing with several threads with bad arguments
+    test_parallel(100, 100, 0);
+
+    // Test multiplying with transposed views instead of transposed copies, the
+    // last two products having mismatched inner dimensions unless the matrix is
+    // square
+    test_views(reinterpret_cast<int*>(a), 2, 4);
+    test_views(reinterpret_cast<int*>(c), 3, 3);
+
+    // Test transposing files, in one stripe, in many stripes including a
+    // partial last stripe, and in square tiles including partial tiles both
+    // as tall as the matrix and not
+    test_file(2, 4, 1 << 20);
+    test_file(1000, 16, 1 << 16);
+    test_file(300, 517, 1 << 20);
+    test_file(300, 517, 64 * 517);
+
+    // Test transposing files with too little memory for one row, and for one
+    // element
+    test_file(300, 517, 1024);
+    test_file(300, 517, 4);
 }
@@ -0,0 +1,61 @@
+// Transpose a matrix held in a binary file, converting it from row-major to
+// column-major
+//
+// Usage: transpose_file <input> <output> <rows> <cols> [<memory MiB>]
+//
+// The input holds rows x cols native ints in row-major order. It is streamed
+// through memory a tile at a time, so peak memory use is bounded by the memory
+// limit (256 MiB by default) however large the matrix is. Each read and write
+// is a run of at least about sqrt(2 * memory) bytes, or 23 KiB by default, so
+// a larger limit makes for fewer, larger I/Os.
+
+#include <cerrno>       // For errno
+#include <cstdlib>      // For std::strtoul
+#include <cstring>      // For std::strerror
+#include <iostream>     // For std::cout etc
+
+#include <fcntl.h>      // For open
+#include <unistd.h>     // For close
+
+#include "matrix_transpose.hpp"
+
+int main(int argc, char* argv[]) {
+    if(argc < 5 || argc > 6) {
+        std::cout << "Usage: " << argv[0] << " <input> <output> <rows> <cols> [<memory MiB>]" << std::endl;
+        std::cout << "Uses at most about <memory MiB> (256 by default), in reads and writes of at least" << std::endl;
+        std::cout << "about sqrt(2 * <memory>) bytes each" << std::endl;
+        return 1;
+    }
+
+    unsigned int rows = std::strtoul(argv[3], nullptr, 10);
+    unsigned int cols = std::strtoul(argv[4], nullptr, 10);
+    std::size_t memory = ((argc > 5) ? std::strtoul(argv[5], nullptr, 10) : 256) << 20;
+
+    int in = open(argv[1], O_RDONLY);
+    if(in < 0) {
+        std::cout << argv[1] << ": " << std::strerror(errno) << std::endl;
+        return 1;
+    }
+    int out = open(argv[2], O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(out < 0) {
+        std::cout << argv[2] << ": " << std::strerror(errno) << std::endl;
+        close(in);
+        return 1;
+    }
+
+    int result = 0;
+    try {
+        transpose_file(in, out, rows, cols, memory);
+    }
+    catch(std::exception& e) {
+        std::cout << e.what() << std::endl;
+        result = 1;
+    }
+
+    close(in);
+    if(close(out) != 0) {
+        std::cout << argv[2] << ": " << std::strerror(errno) << std::endl;
+        result = 1;
+    }
+    return result;
+}
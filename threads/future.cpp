@@ -0,0 +1,98 @@
+// Futures and promises with continuations, when_all and when_any, running on
+// a ThreadPool
+
+#include <chrono>       // For steady_clock, milliseconds
+#include <iostream>     // For cout etc
+#include <stdexcept>    // For runtime_error
+#include <string>       // For string, to_string
+#include <thread>       // For sleep_for
+#include <utility>      // For pair
+#include <vector>       // For vector
+
+#include "future.hpp"
+#include "logger.hpp"
+#include "pool.hpp"
+
+using namespace std;
+
+// Continuations log from the pool's workers, so go through the logger
+Logger logger {cout};
+
+// Milliseconds since the start of the program
+long long elapsed() {
+    static const chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    return chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start).count();
+}
+
+// A task that takes a while
+int slow(int i, int milliseconds) {
+    this_thread::sleep_for(chrono::milliseconds(milliseconds));
+    return i;
+}
+
+int main() {
+    elapsed();
+    ThreadPool pool(8);
+
+    // Chain continuations, each running as soon as the previous step is ready
+    Future<string> answer = spawn(pool, []() { return 6; })
+                                .then([](int x) { return x * 7; })
+                                .then([](int x) { return "the answer is " + to_string(x); });
+    logger.log() << "main():    " << answer.get();
+
+    // An exception skips the continuations and comes out of get()
+    Future<int> failed = spawn(pool, []() -> int { throw runtime_error("Thrown by a task"); })
+                             .then([](int x) { logger.log() << "then():    not called"; return x; });
+    bool threw = false;
+    try {
+        failed.get();
+    }
+    catch(exception& e) {
+        logger.log() << "main():    " << e.what();
+        threw = true;
+    }
+
+    // Each result is handled when it is ready, not in the order the tasks were
+    // started, and the total is handled when they are all ready
+    vector<Future<int>> handled;
+    for(int i = 0; i < 4; i++) {
+        int milliseconds = 200 - 50 * i;
+        handled.push_back(spawn(pool, [i, milliseconds]() { return slow(i, milliseconds); })
+                              .then([](int i) {
+                                  logger.log() << "then():    task " << i << " finished at " << elapsed() << "ms";
+                                  return i * i;
+                              }));
+    }
+    Future<int> total = when_all(handled).then([](const vector<int>& squares) {
+        int sum = 0;
+        for(int square : squares) {
+            sum += square;
+        }
+        logger.log() << "when_all:  sum of squares " << sum << " at " << elapsed() << "ms";
+        return sum;
+    });
+
+    // Results that would share a word in a vector<bool> are gathered safely
+    vector<Future<bool>> flags;
+    for(int i = 0; i < 64; i++) {
+        flags.push_back(spawn(pool, [i]() { return i % 3 == 0; }));
+    }
+    vector<bool> gathered = when_all(flags).get();
+    bool flags_correct = (gathered.size() == 64);
+    for(size_t i = 0; flags_correct && (i < gathered.size()); i++) {
+        flags_correct = (gathered[i] == (i % 3 == 0));
+    }
+
+    // The first of several tasks to finish wins, task 2 having the shortest sleep
+    vector<Future<int>> racers;
+    for(int i = 0; i < 4; i++) {
+        racers.push_back(spawn(pool, [i]() { return slow(i, 30 + 20 * ((i + 2) % 4)); }));
+    }
+    pair<size_t, int> winner = when_any(racers).get();
+    logger.log() << "when_any:  task " << winner.first << " finished first at " << elapsed() << "ms";
+
+    bool correct = (answer.get() == "the answer is 42") && threw && (total.get() == 14) && flags_correct
+                   && (winner.first == 2) && (winner.second == 2);
+    logger.log() << "main():    done at " << elapsed() << "ms, " << (correct ? "correct" : "incorrect");
+    return correct ? 0 : 1;
+}
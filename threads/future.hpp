@@ -0,0 +1,298 @@
+// Futures and promises whose results can be chained with continuations and
+// combined with when_all and when_any, running the follow-on work on a
+// ThreadPool instead of blocking a thread to wait for each result
+
+#ifndef FUTURE_H
+#define FUTURE_H
+
+#include <atomic>               // For atomic
+#include <condition_variable>   // For condition_variable
+#include <cstddef>              // For size_t
+#include <exception>            // For exception_ptr, current_exception, rethrow_exception
+#include <functional>           // For function
+#include <memory>               // For shared_ptr, make_shared, unique_ptr
+#include <mutex>                // For mutex, lock_guard, unique_lock
+#include <stdexcept>            // For runtime_error
+#include <type_traits>          // For result_of
+#include <utility>              // For move, pair
+#include <vector>               // For vector
+
+#include "pool.hpp"
+
+// The result of a function returning void, so that every future has a value
+struct Unit {};
+
+// Call a function and return its result, or Unit if it returns void
+template<typename R>
+struct Lift {
+    typedef R type;
+
+    template<typename F, typename... Args>
+    static R call(F& f, Args&&... args) { return f(std::forward<Args>(args)...); }
+};
+
+template<>
+struct Lift<void> {
+    typedef Unit type;
+
+    template<typename F, typename... Args>
+    static Unit call(F& f, Args&&... args) { f(std::forward<Args>(args)...); return Unit(); }
+};
+
+// The state shared by a promise and its futures: the value or exception once
+// there is one, and the continuations waiting for it
+template<typename T>
+class SharedState {
+public:
+    SharedState(ThreadPool& pool) : pool(pool), ready(false) {}
+
+    ThreadPool& pool;                                       // where the continuations run
+
+    void set(const T* value, std::exception_ptr error);     // make the result ready and schedule the continuations
+    void subscribe(Task continuation);                      // run continuation on the pool once the result is ready
+    void wait();                                            // block until the result is ready
+    bool is_ready();                                        // is the result ready?
+    T get();                                                // block until the result is ready, then return or rethrow it
+
+private:
+    std::mutex mutex;
+    std::condition_variable done;
+    bool ready;
+    T value;
+    std::exception_ptr error;
+    std::vector<Task> continuations;
+};
+
+// Make the result ready and schedule the continuations
+template<typename T>
+void SharedState<T>::set(const T* result, std::exception_ptr failure) {
+    std::vector<Task> waiting;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if(ready) {
+            throw std::runtime_error("Invalid operation: the promise already has a result");
+        }
+        if(result != nullptr) {
+            value = *result;
+        }
+        error = failure;
+        ready = true;
+        waiting.swap(continuations);
+    }
+    done.notify_all();
+    for(Task& continuation : waiting) {
+        pool.post(std::move(continuation));
+    }
+}
+
+// Run continuation on the pool once the result is ready, straight away if it already is
+template<typename T>
+void SharedState<T>::subscribe(Task continuation) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if(!ready) {
+            continuations.push_back(std::move(continuation));
+            return;
+        }
+    }
+    pool.post(std::move(continuation));
+}
+
+// Block until the result is ready
+template<typename T>
+void SharedState<T>::wait() {
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [this]() { return ready; });
+}
+
+// Is the result ready?
+template<typename T>
+bool SharedState<T>::is_ready() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return ready;
+}
+
+// Block until the result is ready, then return or rethrow it
+template<typename T>
+T SharedState<T>::get() {
+    wait();
+    if(error) {
+        std::rethrow_exception(error);
+    }
+    return value;
+}
+
+template<typename T> class Future;
+
+// The producing side: set a value or an exception once, which makes every
+// future from get_future() ready
+template<typename T>
+class Promise {
+public:
+    Promise(ThreadPool& pool) : state(std::make_shared<SharedState<T>>(pool)) {}  // constructor - continuations will run on pool
+
+    Future<T> get_future() const { return Future<T>(state); }
+    void set_value(const T& value) const { state->set(&value, nullptr); }
+    void set_exception(std::exception_ptr error) const { state->set(nullptr, error); }
+
+private:
+    std::shared_ptr<SharedState<T>> state;
+};
+
+// The consuming side of a result. Unlike std::future it may be copied, and
+// each copy may be waited on or continued from. T must be default
+// constructible and copyable
+//
+// get() and wait() block the calling thread, so they are for the edges of a
+// program, such as main(). Within the pool, use then() to run the next step
+// as soon as the result is ready without any thread waiting for it
+template<typename T>
+class Future {
+public:
+    bool ready() const { return state->is_ready(); }       // is the result ready?
+    void wait() const { state->wait(); }                    // block until the result is ready
+    T get() const { return state->get(); }                  // block until the result is ready, then return or rethrow it
+
+    template<typename F>
+    Future<typename Lift<typename std::result_of<F(const T&)>::type>::type> then(F f) const;    // run f(result) on the pool when ready
+
+    template<typename U>
+    friend class Future;
+    friend class Promise<T>;
+
+    template<typename U>
+    friend Future<std::vector<U>> when_all(const std::vector<Future<U>>& futures);
+    template<typename U>
+    friend Future<std::pair<size_t, U>> when_any(const std::vector<Future<U>>& futures);
+
+private:
+    Future(const std::shared_ptr<SharedState<T>>& state) : state(state) {}
+
+    std::shared_ptr<SharedState<T>> state;
+};
+
+// Run f(result) on the pool when this future is ready, returning a future for
+// what f returns (Unit if it returns void). If this future holds an exception
+// f is not called and the exception is passed on, as is any exception f throws
+template<typename T>
+template<typename F>
+Future<typename Lift<typename std::result_of<F(const T&)>::type>::type> Future<T>::then(F f) const {
+    typedef typename std::result_of<F(const T&)>::type Result;
+    typedef typename Lift<Result>::type R;
+
+    Promise<R> next(state->pool);
+    std::shared_ptr<SharedState<T>> previous = state;
+    state->subscribe([previous, next, f]() mutable {
+        try {
+            T value = previous->get();   // ready, so this does not block
+            R result = Lift<Result>::call(f, value);
+            next.set_value(result);
+        }
+        catch(...) {
+            next.set_exception(std::current_exception());
+        }
+    });
+    return next.get_future();
+}
+
+// Run f() on the pool, returning a future for what it returns (Unit if it
+// returns void)
+template<typename F>
+Future<typename Lift<typename std::result_of<F()>::type>::type> spawn(ThreadPool& pool, F f) {
+    typedef typename std::result_of<F()>::type Result;
+    typedef typename Lift<Result>::type R;
+
+    Promise<R> promise(pool);
+    pool.post([promise, f]() mutable {
+        try {
+            R result = Lift<Result>::call(f);
+            promise.set_value(result);
+        }
+        catch(...) {
+            promise.set_exception(std::current_exception());
+        }
+    });
+    return promise.get_future();
+}
+
+// A future for all the results, in the same order, ready once every future is
+// ready. If any future holds an exception the first one to be seen is passed
+// on. The futures must all run on the same pool and there must be at least one
+template<typename T>
+Future<std::vector<T>> when_all(const std::vector<Future<T>>& futures) {
+    if(futures.empty()) {
+        throw std::runtime_error("Bad arguments");
+    }
+
+    // Shared by the continuations, the last one to finish sets the result.
+    // The results are gathered in a plain array rather than the vector, since
+    // the continuations write them concurrently and a vector<bool> packs
+    // neighbouring elements into the same word
+    struct Gather {
+        const size_t n;
+        std::unique_ptr<T[]> results;
+        std::atomic<size_t> remaining;
+        std::atomic<bool> failed;
+        Promise<std::vector<T>> promise;
+
+        Gather(size_t n, ThreadPool& pool) : n(n), results(new T[n]), remaining(n), failed(false), promise(pool) {}
+    };
+
+    std::shared_ptr<Gather> gather = std::make_shared<Gather>(futures.size(), futures[0].state->pool);
+    for(size_t i = 0; i < futures.size(); i++) {
+        std::shared_ptr<SharedState<T>> state = futures[i].state;
+        state->subscribe([gather, state, i]() {
+            try {
+                gather->results[i] = state->get();
+            }
+            catch(...) {
+                if(!gather->failed.exchange(true)) {
+                    gather->promise.set_exception(std::current_exception());
+                }
+            }
+            // Each result is written before the count goes down, so the last
+            // continuation sees them all
+            if((gather->remaining.fetch_sub(1) == 1) && !gather->failed.load()) {
+                gather->promise.set_value(std::vector<T>(gather->results.get(), gather->results.get() + gather->n));
+            }
+        });
+    }
+    return gather->promise.get_future();
+}
+
+// A future for the index and result of the first future to be ready. The
+// others are still run but their results are ignored. The futures must all
+// run on the same pool and there must be at least one
+template<typename T>
+Future<std::pair<size_t, T>> when_any(const std::vector<Future<T>>& futures) {
+    if(futures.empty()) {
+        throw std::runtime_error("Bad arguments");
+    }
+
+    // Shared by the continuations, the first one to finish sets the result
+    struct First {
+        std::atomic<bool> done;
+        Promise<std::pair<size_t, T>> promise;
+
+        First(ThreadPool& pool) : done(false), promise(pool) {}
+    };
+
+    std::shared_ptr<First> first = std::make_shared<First>(futures[0].state->pool);
+    for(size_t i = 0; i < futures.size(); i++) {
+        std::shared_ptr<SharedState<T>> state = futures[i].state;
+        state->subscribe([first, state, i]() {
+            if(first->done.exchange(true)) {
+                return;
+            }
+            try {
+                first->promise.set_value(std::make_pair(i, state->get()));
+            }
+            catch(...) {
+                first->promise.set_exception(std::current_exception());
+            }
+        });
+    }
+    return first->promise.get_future();
+}
+
+#endif
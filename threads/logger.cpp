@@ -0,0 +1,166 @@
+// A logger where each thread appends records to its own circular buffer and a
+// background thread merges them in timestamp order, with a benchmark against
+// locking a mutex around an output stream
+//
+// Usage: logger [<threads>]
+//
+// Each thread (4 by default) logs BURSTS bursts of BURST lines, both through
+// the logger and through a mutex around a stream writing to /dev/null, and the
+// average cost of logging a line on the calling thread is reported. Only the
+// bursts are timed, and each is followed by a pause so that the logger's
+// thread can catch up, as in a program that does more than log. The merged
+// output of the logger is then checked: every line must be there, with each
+// thread's lines in the order they were logged.
+
+#include <atomic>       // For atomic
+#include <chrono>       // For steady_clock, milliseconds
+#include <cstdio>       // For sscanf
+#include <cstdlib>      // For atoi
+#include <fstream>      // For ofstream
+#include <iostream>     // For cout etc
+#include <mutex>        // For mutex, lock_guard
+#include <ostream>      // For ostream
+#include <stdexcept>    // For logic_error
+#include <sstream>      // For ostringstream, istringstream
+#include <string>       // For string
+#include <thread>       // For thread, sleep_for, yield
+#include <vector>       // For vector
+
+#include "logger.hpp"
+
+using namespace std;
+
+// Lines logged by each thread, in bursts
+const unsigned int BURSTS = 200;
+const unsigned int BURST = 256;
+
+// A value that takes a while to format, flagging when it has started
+struct Slow {
+    atomic<bool>& started;
+};
+
+ostream& operator<<(ostream& out, const Slow& slow) {
+    slow.started.store(true);
+    this_thread::sleep_for(chrono::milliseconds(30));
+    return out << "formatted";
+}
+
+// Run log(t, i) for BURSTS bursts of BURST lines on each of nthreads threads
+// at once, returning the average nanoseconds per line spent in the bursts
+template<typename F>
+double per_line(unsigned int nthreads, F log) {
+    vector<double> elapsed(nthreads);
+    vector<thread> threads;
+    for(unsigned int t = 0; t < nthreads; t++) {
+        threads.emplace_back([&, t]() {
+            for(unsigned int i = 0; i < BURSTS * BURST; ) {
+                auto start = chrono::steady_clock::now();
+                for(unsigned int end = i + BURST; i < end; i++) {
+                    log(t, i);
+                }
+                elapsed[t] += chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+                this_thread::sleep_for(chrono::milliseconds(2));
+            }
+        });
+    }
+    double total = 0.0;
+    for(unsigned int t = 0; t < nthreads; t++) {
+        threads[t].join();
+        total += elapsed[t];
+    }
+    return total / nthreads / (BURSTS * BURST);
+}
+
+int main(int argc, char* argv[]) {
+    unsigned int nthreads = (argc > 1) ? atoi(argv[1]) : 4;
+    if(nthreads == 0) {
+        cout << "Usage: " << argv[0] << " [<threads>]" << endl;
+        return 1;
+    }
+
+    // Lines from several threads come out in the order they were logged
+    {
+        Logger logger(cout);
+        logger.log() << "main():    starting " << 2 << " threads";
+        thread first([&]() { logger.log() << "thread(0): " << 1.5 << " is formatted by ostringstream"; });
+        first.join();
+        thread second([&]() { logger.log() << "thread(1): " << -42 << " and " << 'c' << " are formatted directly"; });
+        second.join();
+        logger.log() << "main():    done";
+    }
+    cout << endl;
+
+    // A line is stamped when it is published, so one that is slow to format
+    // comes out after a line logged on another thread while it was formatting,
+    // even though the hold-back time is long enough to put it first
+    ostringstream slow_lines;
+    {
+        Logger logger(slow_lines, chrono::milliseconds(100));
+        atomic<bool> started(false);
+        thread slow([&]() { logger.log() << "slow: " << Slow{started}; });
+        while(!started.load()) {
+            this_thread::yield();
+        }
+        logger.log() << "fast";
+        slow.join();
+    }
+    cout << "A slow line and a fast line logged during it: "
+         << ((slow_lines.str() == "fast\nslow: formatted\n") ? "correct" : "incorrect") << endl;
+
+    // Starting a line before the last one on the same thread has ended throws,
+    // rather than overwriting it
+    ostringstream nested_lines;
+    bool threw = false;
+    {
+        Logger logger(nested_lines);
+        LogLine outer = logger.log();
+        outer << "outer";
+        try {
+            logger.log() << "inner";
+        }
+        catch(logic_error&) {
+            threw = true;
+        }
+    }
+    cout << "A nested line: " << ((threw && (nested_lines.str() == "outer\n")) ? "correct" : "incorrect") << endl;
+    cout << endl;
+
+    // Both ways of logging write to /dev/null, so only the cost on the calling
+    // thread is compared, the logger's buffers being big enough not to wait
+    ofstream null("/dev/null");
+    mutex mutx;
+    double locked = per_line(nthreads, [&](unsigned int t, unsigned int i) {
+        lock_guard<mutex> lock(mutx);
+        null << "thread(" << t << "): line " << i << endl;
+    });
+
+    double buffered = 0.0;
+    ostringstream merged;
+    {
+        Logger logger(merged);
+        buffered = per_line(nthreads, [&](unsigned int t, unsigned int i) {
+            logger.log() << "thread(" << t << "): line " << i;
+        });
+    }
+    cout << nthreads << " threads logging " << BURSTS << " bursts of " << BURST << " lines each" << endl;
+    cout << "Mutex around a stream: " << locked << " ns per line" << endl;
+    cout << "Per-thread buffers:    " << buffered << " ns per line" << endl;
+
+    // Check the merged output
+    istringstream lines(merged.str());
+    vector<long> next(nthreads, 0);
+    string line;
+    unsigned long count = 0;
+    bool in_order = true;
+    while(getline(lines, line)) {
+        unsigned int t = 0;
+        long i = 0;
+        if(sscanf(line.c_str(), "thread(%u): line %ld", &t, &i) != 2 || t >= nthreads || i != next[t]) {
+            in_order = false;
+            break;
+        }
+        next[t]++;
+        count++;
+    }
+    cout << "Merged " << count << " lines, " << ((in_order && count == nthreads * BURSTS * BURST) ? "correct" : "incorrect") << endl;
+}
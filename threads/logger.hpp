@@ -0,0 +1,374 @@
+// A logger where each thread appends records to its own circular buffer and a
+// background thread merges them in timestamp order and writes them out
+
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <algorithm>    // For min, stable_sort
+#include <atomic>       // For atomic
+#include <chrono>       // For steady_clock, milliseconds
+#include <cstddef>      // For size_t
+#include <cstdlib>      // For free
+#include <cstring>      // For memcpy
+#include <memory>       // For shared_ptr
+#include <mutex>        // For mutex, lock_guard
+#include <new>          // For bad_alloc
+#include <ostream>      // For ostream
+#include <stdexcept>    // For logic_error
+#include <sstream>      // For ostringstream
+#include <string>       // For string
+#include <thread>       // For thread, sleep_for, yield
+#include <vector>       // For vector
+
+#include <stdlib.h>     // For posix_memalign
+
+// A log record, a fixed size so that it fits in a slot of a circular buffer.
+// Longer lines are truncated
+struct LogRecord {
+    static const size_t TEXT = 116;
+
+    long long timestamp;        // steady_clock ticks when the line was published
+    unsigned int length;
+    char text[TEXT];
+};
+
+// A single-producer/single-consumer circular buffer of records for one thread
+//
+// head and tail are free-running counters of the records read and written,
+// each written by one side only, released after the record it covers has been
+// copied and acquired by the other side. The producer keeps a cached copy of
+// head and only reloads it when the buffer looks full
+//
+// Only one record may be reserved at a time. A second reserve() before the
+// first is committed, as from a log statement that calls a function which
+// itself logs, would hand out the same record again, so it throws instead
+//
+// head and the producer's fields are on cache lines of their own. Before C++17
+// new does not honour that alignment by itself, so the buffer allocates its own
+class LogRing {
+public:
+    static const size_t CACHE_LINE = 64;
+
+    LogRing(size_t n) : records(new LogRecord[n]), mask(n - 1), head(0), tail(0), cached_head(0),
+                        reserved(false), done(false) {}
+    ~LogRing() { delete[] records; }
+
+    static void* operator new(size_t size);                 // allocate on a cache line boundary
+    static void operator delete(void* memory);
+
+    LogRecord& reserve();                                   // producer only - the next free record, waiting while full
+    void commit();                                          // producer only - publish the record from reserve()
+    void close() { done.store(true, std::memory_order_release); }  // producer only - there will be no more records
+
+    size_t drain(std::vector<LogRecord>& into);             // consumer only - move all the records out, returning how many
+    bool closed() const { return done.load(std::memory_order_acquire); }   // consumer only - has the producer finished?
+
+private:
+    LogRing(const LogRing&) = delete;
+    LogRing& operator=(const LogRing&) = delete;
+
+    LogRecord* const records;
+    const size_t mask;                                      // capacity - 1, the capacity being a power of 2
+
+    alignas(CACHE_LINE) std::atomic<size_t> head;           // written by the consumer
+    alignas(CACHE_LINE) std::atomic<size_t> tail;           // written by the producer
+    size_t cached_head;                                     // producer only
+    bool reserved;                                          // producer only - between reserve() and commit()
+    alignas(CACHE_LINE) std::atomic<bool> done;
+};
+
+// Allocate a buffer on a cache line boundary
+inline void* LogRing::operator new(size_t size) {
+    void* memory = nullptr;
+    if(posix_memalign(&memory, CACHE_LINE, size) != 0) {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+
+inline void LogRing::operator delete(void* memory) {
+    free(memory);
+}
+
+// The next free record, waiting for the background thread while the buffer is full
+inline LogRecord& LogRing::reserve() {
+    if(reserved) {
+        throw std::logic_error("Nested log line: a line was started before the previous one on this thread ended");
+    }
+    reserved = true;
+
+    size_t position = tail.load(std::memory_order_relaxed);
+    while(position - cached_head > mask) {
+        cached_head = head.load(std::memory_order_acquire);
+        if(position - cached_head > mask) {
+            std::this_thread::yield();
+        }
+    }
+    return records[position & mask];
+}
+
+// Publish the record from reserve()
+inline void LogRing::commit() {
+    reserved = false;
+    tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+// Move all the records out, returning how many
+inline size_t LogRing::drain(std::vector<LogRecord>& into) {
+    size_t position = head.load(std::memory_order_relaxed);
+    size_t end = tail.load(std::memory_order_acquire);
+    for(size_t i = position; i < end; i++) {
+        into.push_back(records[i & mask]);
+    }
+    head.store(end, std::memory_order_release);
+    return end - position;
+}
+
+// One line being logged, written straight into a record in the thread's
+// buffer and published when the line is destroyed, at the end of the statement:
+//
+//     logger.log() << "thread(" << i << "): woke up";
+//
+// The line is timestamped when it is published rather than when it is started,
+// so that however long the formatting takes, the timestamps in each buffer
+// only go up and a record is never older than the ones already drained. A
+// statement must not log another line while its own is open (see LogRing)
+//
+// Strings, characters and integers are formatted directly. Anything else is
+// formatted with its operator<< through an ostringstream, which is slower
+class LogLine {
+public:
+    LogLine(LogRing& ring);
+    LogLine(LogLine&& rhs);
+    ~LogLine();
+
+    LogLine& operator<<(const char* text);
+    LogLine& operator<<(const std::string& text);
+    LogLine& operator<<(char c);
+    LogLine& operator<<(int value) { return signed_integer(value); }
+    LogLine& operator<<(long value) { return signed_integer(value); }
+    LogLine& operator<<(long long value) { return signed_integer(value); }
+    LogLine& operator<<(unsigned int value) { return unsigned_integer(value); }
+    LogLine& operator<<(unsigned long value) { return unsigned_integer(value); }
+    LogLine& operator<<(unsigned long long value) { return unsigned_integer(value); }
+
+    template<typename T>
+    LogLine& operator<<(const T& value);
+
+private:
+    LogLine(const LogLine&) = delete;
+    LogLine& operator=(const LogLine&) = delete;
+
+    void append(const char* text, size_t length);
+    LogLine& signed_integer(long long value);
+    LogLine& unsigned_integer(unsigned long long value);
+
+    LogRing* ring;                                          // nullptr once moved from
+    LogRecord* record;
+};
+
+// Start a line in the next free record
+inline LogLine::LogLine(LogRing& ring) : ring(&ring), record(&ring.reserve()) {
+    record->length = 0;
+}
+
+inline LogLine::LogLine(LogLine&& rhs) : ring(rhs.ring), record(rhs.record) {
+    rhs.ring = nullptr;
+}
+
+// Timestamp and publish the line
+inline LogLine::~LogLine() {
+    if(ring != nullptr) {
+        record->timestamp = std::chrono::steady_clock::now().time_since_epoch().count();
+        ring->commit();
+    }
+}
+
+// Append text, truncating the line if it is too long
+inline void LogLine::append(const char* text, size_t length) {
+    length = std::min(length, LogRecord::TEXT - record->length);
+    std::memcpy(record->text + record->length, text, length);
+    record->length += length;
+}
+
+inline LogLine& LogLine::operator<<(const char* text) {
+    append(text, std::strlen(text));
+    return *this;
+}
+
+inline LogLine& LogLine::operator<<(const std::string& text) {
+    append(text.data(), text.size());
+    return *this;
+}
+
+inline LogLine& LogLine::operator<<(char c) {
+    append(&c, 1);
+    return *this;
+}
+
+inline LogLine& LogLine::signed_integer(long long value) {
+    if(value < 0) {
+        append("-", 1);
+        return unsigned_integer(0ULL - static_cast<unsigned long long>(value));
+    }
+    return unsigned_integer(value);
+}
+
+inline LogLine& LogLine::unsigned_integer(unsigned long long value) {
+    char digits[20];
+    size_t n = sizeof(digits);
+    do {
+        digits[--n] = '0' + value % 10;
+        value /= 10;
+    } while(value != 0);
+    append(digits + n, sizeof(digits) - n);
+    return *this;
+}
+
+template<typename T>
+LogLine& LogLine::operator<<(const T& value) {
+    std::ostringstream text;
+    text << value;
+    return *this << text.str();
+}
+
+// Logging only touches the calling thread's own buffer: there is no lock and
+// no shared cache line on the hot path, just a clock read, the formatting and a
+// release store. The first line from each thread registers its buffer, which
+// takes a lock once
+//
+// The background thread wakes every millisecond, drains every buffer and sorts
+// what it has by timestamp. A record is only written out once it is older than
+// the hold-back time, so that records from threads that were preempted between
+// reading the clock and publishing can still be put in order ahead of it. Records from one thread
+// always stay in the order they were logged. Destroying the logger writes out
+// everything that is left
+class Logger {
+public:
+    Logger(std::ostream& out, std::chrono::milliseconds hold_back = std::chrono::milliseconds(10),
+           size_t nrecords = 1024);                         // constructor - start the background thread writing to out
+    ~Logger();                                              // destructor - write out all the records, then stop
+
+    LogLine log();                                          // start a line, which is published at the end of the statement
+
+private:
+    Logger(const Logger&) = delete;
+    Logger& operator=(const Logger&) = delete;
+
+    LogRing& ring();                                        // the calling thread's buffer, created on first use
+    void flush(long long cutoff);                           // drain the buffers and write out the records older than cutoff
+    void run();                                             // the start routine for the background thread
+
+    // A thread's buffer for one logger, closed when the thread exits
+    struct Registration {
+        unsigned long id;
+        std::shared_ptr<LogRing> ring;
+
+        Registration(unsigned long id, const std::shared_ptr<LogRing>& ring) : id(id), ring(ring) {}
+        Registration(Registration&& rhs) = default;
+        ~Registration() { if(ring) ring->close(); }
+    };
+
+    static unsigned long next_id();                         // a different id for every logger
+
+    const unsigned long id;
+    std::ostream& out;
+    const long long hold_back;                              // in steady_clock ticks
+    const size_t capacity;                                  // records per buffer, a power of 2
+
+    std::mutex mutex;                                       // protects rings
+    std::vector<std::shared_ptr<LogRing>> rings;
+
+    std::vector<LogRecord> pending;                         // background thread only - drained but not written yet
+    std::atomic<bool> stopping;
+    std::thread writer;
+};
+
+// Constructor - start the background thread writing to out
+inline Logger::Logger(std::ostream& out, std::chrono::milliseconds hold_back, size_t nrecords)
+    : id(next_id()), out(out), hold_back(std::chrono::duration_cast<std::chrono::steady_clock::duration>(hold_back).count()),
+      capacity([nrecords]() { size_t n = 1; while(n < nrecords) n <<= 1; return n; }()),
+      stopping(false), writer(&Logger::run, this) {
+}
+
+// Destructor - write out all the records, then stop
+inline Logger::~Logger() {
+    stopping.store(true);
+    writer.join();
+}
+
+// Start a line, which is published at the end of the statement
+inline LogLine Logger::log() {
+    return LogLine(ring());
+}
+
+// A different id for every logger, so that a new logger at the same address
+// as a destroyed one is not mistaken for it
+inline unsigned long Logger::next_id() {
+    static std::atomic<unsigned long> count(0);
+    return ++count;
+}
+
+// The calling thread's buffer, created on first use
+//
+// The background thread shares ownership of the buffer, so that it can still
+// drain it after the thread exits
+inline LogRing& Logger::ring() {
+    static thread_local std::vector<Registration> registrations;
+    for(Registration& registration : registrations) {
+        if(registration.id == id) {
+            return *registration.ring;
+        }
+    }
+
+    std::shared_ptr<LogRing> created(new LogRing(capacity));   // not make_shared, which would not align it
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        rings.push_back(created);
+    }
+    registrations.emplace_back(id, created);
+    return *created;
+}
+
+// Drain the buffers and write out the records older than cutoff
+inline void Logger::flush(long long cutoff) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for(size_t i = 0; i < rings.size(); ) {
+            bool closed = rings[i]->closed();
+            rings[i]->drain(pending);
+            if(closed) {
+                // The thread has exited and everything it logged has been drained
+                rings.erase(rings.begin() + i);
+            }
+            else {
+                i++;
+            }
+        }
+    }
+
+    // Each buffer was drained in order, and a stable sort keeps it that way
+    std::stable_sort(pending.begin(), pending.end(),
+                     [](const LogRecord& a, const LogRecord& b) { return a.timestamp < b.timestamp; });
+
+    size_t n = 0;
+    for( ; (n < pending.size()) && (pending[n].timestamp < cutoff); n++) {
+        out.write(pending[n].text, pending[n].length);
+        out.put('\n');
+    }
+    if(n > 0) {
+        out.flush();
+        pending.erase(pending.begin(), pending.begin() + n);
+    }
+}
+
+// The start routine for the background thread
+inline void Logger::run() {
+    while(!stopping.load()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        flush(std::chrono::steady_clock::now().time_since_epoch().count() - hold_back);
+    }
+    flush(std::chrono::steady_clock::duration::max().count());
+}
+
+#endif
@@ -0,0 +1,221 @@
+// A reusable work-stealing thread pool, with a benchmark against creating a
+// thread per task and against a pool sharing a single queue
+//
+// Usage: pool [<threads>]
+//
+// Two workloads are run with the given number of workers (the number of
+// hardware threads by default):
+// - flat: many small independent tasks submitted from main(), each returning
+//   a result through a future
+// - tree: one task that recursively spawns two subtasks down to a fixed depth,
+//   counting the leaves, as divide-and-conquer algorithms do
+// Thread-per-task only runs the flat workload, with fewer tasks since creating
+// a thread each time is so slow.
+
+#include <atomic>               // For atomic
+#include <chrono>               // For steady_clock
+#include <condition_variable>   // For condition_variable
+#include <cstdlib>              // For atoi
+#include <deque>                // For deque
+#include <functional>           // For function
+#include <future>               // For future, promise
+#include <iomanip>              // For setw
+#include <iostream>             // For cout etc
+#include <mutex>                // For mutex
+#include <string>               // For string
+#include <thread>               // For thread
+#include <vector>               // For vector
+
+#include "pool.hpp"
+
+using namespace std;
+
+// Number of tasks in the flat workload, and for thread-per-task
+const unsigned int FLAT_TASKS = 200000;
+const unsigned int THREAD_TASKS = 5000;
+
+// Depth of the tree workload, which has 2^DEPTH leaves
+const unsigned int DEPTH = 17;
+
+// A pool where every worker takes tasks from one queue protected by a mutex,
+// to compare against
+class SharedQueuePool {
+public:
+    SharedQueuePool(unsigned int nthreads) : stopping(false) {
+        for(unsigned int i = 0; i < nthreads; i++) {
+            workers.emplace_back([this]() { work(); });
+        }
+    }
+
+    ~SharedQueuePool() {
+        {
+            lock_guard<mutex> lock(mutx);
+            stopping = true;
+        }
+        wake.notify_all();
+        for(thread& worker : workers) {
+            worker.join();
+        }
+    }
+
+    template<typename F>
+    future<typename result_of<F()>::type> submit(F f) {
+        auto task = make_shared<packaged_task<typename result_of<F()>::type()>>(f);
+        auto result = task->get_future();
+        {
+            lock_guard<mutex> lock(mutx);
+            tasks.push_back([task]() { (*task)(); });
+        }
+        wake.notify_one();
+        return result;
+    }
+
+private:
+    void work() {
+        for(;;) {
+            function<void()> task;
+            {
+                unique_lock<mutex> lock(mutx);
+                wake.wait(lock, [this]() { return stopping || !tasks.empty(); });
+                if(tasks.empty()) {
+                    return;
+                }
+                task = move(tasks.front());
+                tasks.pop_front();
+            }
+            task();
+        }
+    }
+
+    vector<thread> workers;
+    mutex mutx;
+    condition_variable wake;
+    deque<function<void()>> tasks;
+    bool stopping;
+};
+
+// A small unit of work
+unsigned long work(unsigned int i) {
+    unsigned long sum = 0;
+    for(unsigned int j = 0; j < 100; j++) {
+        sum += (i * j) ^ j;
+    }
+    return sum;
+}
+
+// The sum of work(i) for i in [0, n)
+unsigned long expected(unsigned int n) {
+    unsigned long sum = 0;
+    for(unsigned int i = 0; i < n; i++) {
+        sum += work(i);
+    }
+    return sum;
+}
+
+// Print one result
+void report(const string& name, const string& workload, unsigned int tasks,
+            chrono::steady_clock::time_point start, bool correct) {
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+    cout << setw(16) << left << name << setw(8) << workload << right
+         << setw(14) << fixed << setprecision(0) << tasks / elapsed.count()
+         << (correct ? "" : "  incorrect") << endl;
+}
+
+// Submit many small tasks and collect their results through futures
+template<typename Pool>
+void flat(const string& name, Pool& pool) {
+    auto start = chrono::steady_clock::now();
+    vector<future<unsigned long>> results;
+    results.reserve(FLAT_TASKS);
+    for(unsigned int i = 0; i < FLAT_TASKS; i++) {
+        results.push_back(pool.submit([i]() { return work(i); }));
+    }
+    unsigned long sum = 0;
+    for(future<unsigned long>& result : results) {
+        sum += result.get();
+    }
+    report(name, "flat", FLAT_TASKS, start, sum == expected(FLAT_TASKS));
+}
+
+// Recursively spawn two subtasks down to depth, counting the leaves
+template<typename Pool>
+void spawn(Pool& pool, unsigned int depth, atomic<unsigned int>& leaves, promise<void>& done) {
+    if(depth == 0) {
+        if(leaves.fetch_add(1) + 1 == (1u << DEPTH)) {
+            done.set_value();
+        }
+        return;
+    }
+    pool.submit([&pool, depth, &leaves, &done]() { spawn(pool, depth - 1, leaves, done); });
+    pool.submit([&pool, depth, &leaves, &done]() { spawn(pool, depth - 1, leaves, done); });
+}
+
+// Run the tree workload, without any task waiting for another
+template<typename Pool>
+void tree(const string& name, Pool& pool) {
+    auto start = chrono::steady_clock::now();
+    atomic<unsigned int> leaves(0);
+    promise<void> done;
+    pool.submit([&]() { spawn(pool, DEPTH, leaves, done); });
+    done.get_future().wait();
+    report(name, "tree", (2u << DEPTH) - 1, start, leaves.load() == (1u << DEPTH));
+}
+
+int main(int argc, char* argv[]) {
+    unsigned int nthreads = (argc > 1) ? atoi(argv[1]) : thread::hardware_concurrency();
+    if(nthreads == 0) {
+        cout << "Usage: " << argv[0] << " [<threads>]" << endl;
+        return 1;
+    }
+
+    // Results come back through futures, and exceptions too
+    {
+        ThreadPool pool(nthreads);
+        future<int> answer = pool.submit([](int a, int b) { return a * b; }, 6, 7);
+        future<void> failure = pool.submit([]() { throw runtime_error("Thrown by a task"); });
+        cout << "Pool of " << pool.size() << " workers, 6 * 7 = " << answer.get() << endl;
+        try {
+            failure.get();
+        }
+        catch(exception& e) {
+            cout << e.what() << endl;
+        }
+
+        // A posted task that throws is dropped, and its worker carries on
+        promise<void> after;
+        pool.post([]() { throw runtime_error("Thrown by a posted task"); });
+        pool.post([&after]() { after.set_value(); });
+        after.get_future().wait();
+        cout << "Posted task after one that threw: ran" << endl;
+    }
+    cout << endl;
+
+    cout << setw(16) << left << "Pool" << setw(8) << "Tasks" << right << setw(14) << "Tasks/s" << endl;
+
+    // A new thread per task, the way threads.cpp works
+    auto start = chrono::steady_clock::now();
+    vector<promise<unsigned long>> promises(THREAD_TASKS);
+    vector<thread> threads;
+    for(unsigned int i = 0; i < THREAD_TASKS; i++) {
+        threads.emplace_back([i, &promises]() { promises[i].set_value(work(i)); });
+    }
+    for(thread& t : threads) {
+        t.join();
+    }
+    unsigned long sum = 0;
+    for(promise<unsigned long>& p : promises) {
+        sum += p.get_future().get();
+    }
+    report("thread-per-task", "flat", THREAD_TASKS, start, sum == expected(THREAD_TASKS));
+
+    {
+        SharedQueuePool pool(nthreads);
+        flat("shared-queue", pool);
+        tree("shared-queue", pool);
+    }
+    {
+        ThreadPool pool(nthreads);
+        flat("work-stealing", pool);
+        tree("work-stealing", pool);
+    }
+}
@@ -0,0 +1,381 @@
+// A reusable pool of worker threads, where each worker has its own deque of
+// tasks and idle workers steal from the others
+
+#ifndef POOL_H
+#define POOL_H
+
+#include <atomic>               // For atomic, atomic_thread_fence
+#include <condition_variable>   // For condition_variable
+#include <cstddef>              // For size_t
+#include <cstdlib>              // For free
+#include <deque>                // For deque
+#include <functional>           // For bind, function
+#include <future>               // For future, packaged_task
+#include <memory>               // For make_shared, unique_ptr
+#include <mutex>                // For mutex, lock_guard, unique_lock
+#include <new>                  // For bad_alloc
+#include <random>               // For minstd_rand
+#include <thread>               // For thread, hardware_concurrency
+#include <type_traits>          // For result_of
+#include <utility>              // For forward, move
+#include <vector>               // For vector
+
+#include <stdlib.h>             // For posix_memalign
+
+// A unit of work
+typedef std::function<void()> Task;
+
+// Size of a cache line, used to keep the owner's and thieves' data apart
+const size_t CACHE_LINE = 64;
+
+// A Chase-Lev work-stealing deque of tasks, using the C++11 memory orderings
+// from "Correct and Efficient Work-Stealing for Weak Memory Models" (Le et al)
+//
+// The owning worker pushes and pops at the bottom without any locks or
+// read-modify-writes, except when taking the last task. Other workers steal
+// from the top with a compare-and-swap. The array grows when full; old arrays
+// are kept until the deque is destroyed, since a thief may still be reading one
+//
+// top and bottom are on cache lines of their own. Before C++17 new does not
+// honour that alignment by itself, so the deque allocates its own
+class alignas(CACHE_LINE) WorkStealingDeque {
+public:
+    WorkStealingDeque(size_t n = 1024);                     // constructor - create a deque to hold n tasks before growing
+    ~WorkStealingDeque();                                   // destructor - destroy the deque and any tasks left in it
+
+    void push(Task* task);                                  // owner only - add a task at the bottom
+    Task* pop();                                            // owner only - take a task from the bottom, or nullptr if empty
+    Task* steal();                                          // take a task from the top, or nullptr if empty or another thread won
+
+    static void* operator new(size_t size);                 // allocate on a cache line boundary
+    static void operator delete(void* memory);
+
+private:
+    WorkStealingDeque(const WorkStealingDeque&) = delete;
+    WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+
+    // A circular array of tasks, with a power of 2 capacity
+    struct Array {
+        const long mask;
+        std::atomic<Task*>* const slots;
+
+        Array(long n) : mask(n - 1), slots(new std::atomic<Task*>[n]) {}
+        ~Array() { delete[] slots; }
+
+        long capacity() const { return mask + 1; }
+        Task* get(long i) const { return slots[i & mask].load(std::memory_order_relaxed); }
+        void put(long i, Task* task) { slots[i & mask].store(task, std::memory_order_relaxed); }
+    };
+
+    Array* grow(Array* array, long bottom, long top);       // owner only - copy the tasks into an array twice the size
+
+    alignas(CACHE_LINE) std::atomic<long> top;              // the next task to steal
+    alignas(CACHE_LINE) std::atomic<long> bottom;           // the next free slot for the owner
+    std::atomic<Array*> array;
+    alignas(CACHE_LINE) std::vector<Array*> retired;        // owner only - arrays replaced by grow()
+};
+
+// Constructor - create a deque to hold n tasks before growing, rounded up to a power of 2
+inline WorkStealingDeque::WorkStealingDeque(size_t n) : top(0), bottom(0), array(nullptr) {
+    long capacity = 1;
+    while(capacity < static_cast<long>(n)) {
+        capacity <<= 1;
+    }
+    array.store(new Array(capacity), std::memory_order_relaxed);
+}
+
+// Destructor - destroy the deque and any tasks left in it
+inline WorkStealingDeque::~WorkStealingDeque() {
+    Array* current = array.load(std::memory_order_relaxed);
+    for(long i = top.load(std::memory_order_relaxed); i < bottom.load(std::memory_order_relaxed); i++) {
+        delete current->get(i);
+    }
+    delete current;
+    for(Array* old : retired) {
+        delete old;
+    }
+}
+
+// Allocate a deque on a cache line boundary
+inline void* WorkStealingDeque::operator new(size_t size) {
+    void* memory = nullptr;
+    if(posix_memalign(&memory, CACHE_LINE, size) != 0) {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+
+inline void WorkStealingDeque::operator delete(void* memory) {
+    free(memory);
+}
+
+// Copy the tasks into an array twice the size
+inline WorkStealingDeque::Array* WorkStealingDeque::grow(Array* old, long b, long t) {
+    Array* bigger = new Array(2 * old->capacity());
+    for(long i = t; i < b; i++) {
+        bigger->put(i, old->get(i));
+    }
+    retired.push_back(old);
+    array.store(bigger, std::memory_order_release);
+    return bigger;
+}
+
+// Add a task at the bottom
+inline void WorkStealingDeque::push(Task* task) {
+    long b = bottom.load(std::memory_order_relaxed);
+    long t = top.load(std::memory_order_acquire);
+    Array* a = array.load(std::memory_order_relaxed);
+    if(b - t > a->capacity() - 1) {
+        a = grow(a, b, t);
+    }
+    a->put(b, task);
+    std::atomic_thread_fence(std::memory_order_release);   // the task is stored before thieves can see it
+    bottom.store(b + 1, std::memory_order_relaxed);
+}
+
+// Take a task from the bottom, or nullptr if empty
+//
+// The bottom is moved down first and then the top is checked, so a thief either
+// sees the smaller deque or is seen here. Only the last task can be wanted by
+// both, and that is settled with a compare-and-swap on the top
+inline Task* WorkStealingDeque::pop() {
+    long b = bottom.load(std::memory_order_relaxed) - 1;
+    Array* a = array.load(std::memory_order_relaxed);
+    bottom.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    long t = top.load(std::memory_order_relaxed);
+
+    if(t > b) {
+        // Empty
+        bottom.store(b + 1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    Task* task = a->get(b);
+    if(t == b) {
+        // The last task, race the thieves for it
+        if(!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            task = nullptr;
+        }
+        bottom.store(b + 1, std::memory_order_relaxed);
+    }
+    return task;
+}
+
+// Take a task from the top, or nullptr if empty or another thread won it
+inline Task* WorkStealingDeque::steal() {
+    long t = top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    long b = bottom.load(std::memory_order_acquire);
+    if(t >= b) {
+        return nullptr;
+    }
+
+    Array* a = array.load(std::memory_order_acquire);
+    Task* task = a->get(t);
+    if(!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+        return nullptr;
+    }
+    return task;
+}
+
+// A fixed set of worker threads that run submitted tasks until the pool is
+// destroyed, so that the cost of creating a thread is paid once per worker
+// rather than once per task
+//
+// Tasks submitted by a worker (for example a task spawning subtasks) go on
+// that worker's own deque, and it takes them back newest first while they are
+// still in its cache. Tasks submitted from outside the pool go on a shared
+// injection queue. A worker with nothing to do takes from the injection queue,
+// then tries to steal the oldest task from randomly chosen workers and then
+// from each worker in turn, and only goes to sleep once no tasks are queued
+class ThreadPool {
+public:
+    ThreadPool(unsigned int nthreads = std::thread::hardware_concurrency());  // constructor - start nthreads workers
+    ~ThreadPool();                                          // destructor - run any tasks still queued, then stop the workers
+
+    size_t size() const;                                    // the number of workers
+
+    template<typename F, typename... Args>
+    std::future<typename std::result_of<F(Args...)>::type> submit(F&& f, Args&&... args);   // run f(args...) on a worker
+
+    void post(Task task);                                   // run task on a worker, without a future for the result
+
+private:
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    void schedule(Task* task);                              // queue a task and wake a worker if any are asleep
+    Task* find_task(unsigned int index, std::minstd_rand& random);  // take a task from anywhere, or nullptr if there are none
+    void work(unsigned int index);                          // the start routine for each worker
+
+    // Which pool and worker the current thread is, if any
+    static ThreadPool*& current_pool();
+    static unsigned int& current_index();
+
+    std::vector<std::unique_ptr<WorkStealingDeque>> deques; // one per worker
+    std::vector<std::thread> workers;
+
+    std::mutex mutex;                                       // protects injected and sleeping on the condition
+    std::condition_variable wake;
+    std::deque<Task*> injected;                             // tasks submitted from outside the pool
+
+    std::atomic<long> queued;                               // tasks waiting to run anywhere in the pool
+    std::atomic<int> sleepers;                              // workers waiting on wake
+    std::atomic<bool> stopping;
+};
+
+// Constructor - start nthreads workers, at least one
+inline ThreadPool::ThreadPool(unsigned int nthreads) : queued(0), sleepers(0), stopping(false) {
+    if(nthreads == 0) {
+        nthreads = 1;
+    }
+    for(unsigned int i = 0; i < nthreads; i++) {
+        deques.emplace_back(new WorkStealingDeque());
+    }
+    for(unsigned int i = 0; i < nthreads; i++) {
+        workers.emplace_back(&ThreadPool::work, this, i);
+    }
+}
+
+// Destructor - run any tasks still queued, then stop the workers
+inline ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping.store(true);
+    }
+    wake.notify_all();
+    for(std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+// The number of workers
+inline size_t ThreadPool::size() const {
+    return workers.size();
+}
+
+// Run f(args...) on a worker, returning a future for its result
+template<typename F, typename... Args>
+std::future<typename std::result_of<F(Args...)>::type> ThreadPool::submit(F&& f, Args&&... args) {
+    typedef typename std::result_of<F(Args...)>::type Result;
+
+    // A packaged_task is move-only, but a Task must be copyable
+    auto task = std::make_shared<std::packaged_task<Result()>>(std::bind(std::forward<F>(f), std::forward<Args>(args)...));
+    std::future<Result> result = task->get_future();
+    schedule(new Task([task]() { (*task)(); }));
+    return result;
+}
+
+// Which pool the current thread is a worker of, if any
+inline ThreadPool*& ThreadPool::current_pool() {
+    static thread_local ThreadPool* pool = nullptr;
+    return pool;
+}
+
+// Which worker of current_pool() the current thread is
+inline unsigned int& ThreadPool::current_index() {
+    static thread_local unsigned int index = 0;
+    return index;
+}
+
+// Run a task on a worker, without a future for the result
+//
+// Any exception the task throws is caught and dropped, so a task that needs
+// to report a failure should catch its own (submit() passes it to the future)
+inline void ThreadPool::post(Task task) {
+    schedule(new Task(std::move(task)));
+}
+
+// Queue a task and wake a worker if any are asleep
+//
+// queued is counted up before sleepers is checked, and a worker counts itself
+// in sleepers before checking queued, so either the worker sees the task or
+// this sees the worker and wakes it
+inline void ThreadPool::schedule(Task* task) {
+    if(current_pool() == this) {
+        deques[current_index()]->push(task);
+    }
+    else {
+        std::lock_guard<std::mutex> lock(mutex);
+        injected.push_back(task);
+    }
+
+    queued.fetch_add(1);
+    if(sleepers.load() > 0) {
+        std::lock_guard<std::mutex> lock(mutex);
+        wake.notify_one();
+    }
+}
+
+// Take a task from the worker's own deque, the injection queue or another
+// worker, or nullptr if there are none
+inline Task* ThreadPool::find_task(unsigned int index, std::minstd_rand& random) {
+    Task* task = deques[index]->pop();
+    if(task == nullptr) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if(!injected.empty()) {
+            task = injected.front();
+            injected.pop_front();
+        }
+    }
+    for(size_t attempt = 0; (task == nullptr) && (attempt < 2 * deques.size()); attempt++) {
+        unsigned int victim = random() % deques.size();
+        if(victim != index) {
+            task = deques[victim]->steal();
+        }
+    }
+
+    // Random victims can keep missing the one worker with tasks, so finish by
+    // trying every worker in turn
+    for(unsigned int victim = 0; (task == nullptr) && (victim < deques.size()); victim++) {
+        if(victim != index) {
+            task = deques[victim]->steal();
+        }
+    }
+    if(task != nullptr) {
+        queued.fetch_sub(1);
+    }
+    return task;
+}
+
+// The start routine for each worker
+inline void ThreadPool::work(unsigned int index) {
+    current_pool() = this;
+    current_index() = index;
+    std::minstd_rand random(index + 1);
+
+    for(;;) {
+        Task* task = find_task(index, random);
+        if(task != nullptr) {
+            try {
+                (*task)();
+            }
+            catch(...) {
+                // There is nowhere to report it, and letting it escape would
+                // terminate the program
+            }
+            delete task;
+            continue;
+        }
+
+        // A task is queued but was not found, because it is being pushed or
+        // another thief won it, so try again rather than sleep on a condition
+        // that is already true
+        if(queued.load() > 0) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        // Nothing queued, sleep until a task is
+        std::unique_lock<std::mutex> lock(mutex);
+        sleepers.fetch_add(1);
+        wake.wait(lock, [this]() { return (queued.load() > 0) || stopping.load(); });
+        sleepers.fetch_sub(1);
+        if(stopping.load() && (queued.load() <= 0)) {
+            return;
+        }
+    }
+}
+
+#endif
@@ -1,17 +1,22 @@
 // Trivial threading example, using the STL
 
 #include <chrono>       // For seconds
-#include <future>       // For future, promise
 #include <iostream>     // For cout
 #include <random>       // For random numbers
 #include <thread>       // For thread
+#include <vector>       // For vector
+
+#include "future.hpp"
+#include "logger.hpp"
+#include "pool.hpp"
 
 using namespace std;
 
 #define NUM_THREADS 10
 
-// Need to lock and unlock around cout to avoid corrupt output
-mutex mutx {};
+// Each thread logs to its own buffer, without locking, and the logger's own
+// thread writes the lines to cout in the order they were logged
+Logger logger {cout};
 
 // Generate a random sleep period, range 1..2000 milliseconds
 long long RandomMilliseconds() {
@@ -29,57 +34,44 @@ long long RandomMilliseconds() {
     // number each time
 }
 
-// The start routine for each thread
-void ThreadFunc(int i, promise<int>& result) {
+// The start routine for each task
+int ThreadFunc(int i) {
     // Identify this thread
     thread::id tid = this_thread::get_id();
 
-    mutx.lock();
-    cout << "thread(" << i << "): thread id = " << tid << endl;
-    mutx.unlock();
+    logger.log() << "thread(" << i << "): thread id = " << tid;
 
     // Sleep for a while
     long long period = RandomMilliseconds();
-    mutx.lock();
-    cout << "thread(" << i << "): sleeping for " << period << "ms"<< endl;
-    mutx.unlock();
+    logger.log() << "thread(" << i << "): sleeping for " << period << "ms";
 
     this_thread::sleep_for(chrono::milliseconds(period));
 
-    mutx.lock();
-    cout << "thread(" << i << "): woke up" << endl;
-    mutx.unlock();
+    logger.log() << "thread(" << i << "): woke up";
 
     // Return a result
-    result.set_value(i);
+    return i;
 }
 
 int main() {
-    // Create some threads, with promises to allow results to be returned
-    promise<int> promises[NUM_THREADS] {};
-    thread threads[NUM_THREADS] {};
-    for(int i = 0; i < NUM_THREADS; i++) {
-        mutx.lock();
-        cout << "main():    creating thread " << i << endl;
-        mutx.unlock();
-
-        threads[i] = thread(ThreadFunc, i /* arg */, ref(promises[i]) /* result */);
-    }
+    // The tasks spend most of their time asleep, so give each one a worker
+    ThreadPool pool(NUM_THREADS);
 
-    // Wait for all threads to complete before exiting
-    mutx.lock();
-    cout << "main():    waiting for all threads to complete" << endl;
-    mutx.unlock();
+    // Start some tasks, handling each result as soon as it is ready rather
+    // than waiting for them in order
+    vector<Future<int>> results;
     for(int i = 0; i < NUM_THREADS; i++) {
-        threads[i].join();
-    }
+        logger.log() << "main():    creating thread " << i;
 
-    // Gather the results
-    for(int i = 0; i < NUM_THREADS; i++) {
-        future<int> fut = promises[i].get_future();
-        int result = fut.get();
-        mutx.lock();
-        cout << "main():    thread " << i << " returned " << result << endl;
-        mutx.unlock();
+        results.push_back(spawn(pool, [i]() { return ThreadFunc(i); })
+                              .then([i](int result) {
+                                  logger.log() << "then():    thread " << i << " returned " << result;
+                                  return result;
+                              }));
     }
+
+    // Wait for all tasks to complete before exiting
+    logger.log() << "main():    waiting for all threads to complete";
+    vector<int> all = when_all(results).get();
+    logger.log() << "main():    all " << all.size() << " threads complete";
 }